@@ -0,0 +1,810 @@
+#ifndef CLUSTER_GRAPH_H
+#define CLUSTER_GRAPH_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "pathfinding.h"
+
+
+// Hierarchical pathfinding (HPA*): every layer is split in clusters of cluster_size x cluster_size rooms, and the
+// rooms where a route can leave a cluster are the nodes of an abstract graph: the middle room of every run of open
+// crossings along a cluster border (on both sides) and both ends of every elevator move. The nodes of a cluster are
+// linked by their shortest distance inside it (one small BFS per node, clusters built on the pool threads), the
+// crossings and elevators by one move. A query links both rooms to the nodes of their clusters and runs A* on the
+// abstract graph, the rooms of a leg are found when it is refined (a BFS inside one cluster). With one crossing per
+// run, routes can be a little longer than the shortest ones.
+// The nodes of a cluster and the edges out of them are kept together, so that a room edit only rewrites the
+// clusters around it (in place when they still fit, at the end of the arrays otherwise, which are compacted once
+// half of them is left behind).
+// The graph is saved next to the maze file and loaded back as long as the walls, room types and elevators hash the
+// same (items do not change the routes).
+
+const char CLUSTER_GRAPH_MAGIC[8] = {'M', 'A', 'Z', 'E', 'H', 'P', 'A', '\0'};
+const std::uint32_t CLUSTER_GRAPH_VERSION = 2;
+const std::uint32_t CLUSTER_GRAPH_BYTE_ORDER = 0x01020304;
+const int CLUSTER_SIZE = 32;
+const std::uint32_t CLUSTER_UNREACHABLE = 0xFFFFFFFF;
+
+typedef struct cluster_graph {
+    int width;
+    int height;
+    int layers;
+    int cluster_size;
+    int cluster_columns;                        // Clusters per cluster row of a layer
+    int cluster_rows;
+    std::uint64_t maze_hash;                    // maze_route_hash() of the maze the graph was built for
+    std::vector<std::uint64_t> node_rooms;          // Room id of every node, the nodes of a cluster together by room
+    std::vector<std::uint32_t> cluster_nodes;       // First node of every cluster
+    std::vector<std::uint32_t> cluster_node_counts;
+    std::vector<std::uint64_t> edge_offsets;        // First edge of every node, the edges of a cluster together
+    std::vector<std::uint32_t> edge_counts;
+    std::vector<std::uint32_t> edge_targets;        // Directed edges (elevators only lead one way)
+    std::vector<std::uint32_t> edge_costs;
+    std::uint64_t unused_nodes;                     // Left behind by update_cluster_graph until the arrays are compacted
+    std::uint64_t unused_edges;
+}cluster_graph;
+
+// Edges out of the nodes of one cluster, node after node
+typedef struct cluster_edges {
+    std::vector<std::uint32_t> counts;
+    std::vector<std::uint32_t> targets;
+    std::vector<std::uint32_t> costs;
+}cluster_edges;
+
+typedef struct cluster_graph_header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order;
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t layers;
+    std::uint32_t cluster_size;
+    std::uint64_t maze_hash;
+    std::uint64_t nodes;
+    std::uint64_t edges;
+}cluster_graph_header;
+
+// BFS state inside one cluster, rooms by local index (row * cluster_size + column inside the cluster)
+typedef struct cluster_search {
+    int layer;
+    int column;                     // First room of the cluster
+    int row;
+    int columns;                    // Cluster size, smaller on the right and front edges of a layer
+    int rows;
+    std::vector<int> distances;     // -1 when not reached
+    std::vector<std::uint8_t> moves;
+    std::vector<int> queue;
+}cluster_search;
+
+// Reusable query state
+typedef struct hpa_query {
+    cluster_search local;
+    std::vector<std::uint32_t> start_costs;     // From the start room to the nodes of its cluster
+    std::vector<std::uint32_t> goal_costs;      // From the nodes of the goal cluster to the goal room
+    std::vector<std::uint32_t> g;               // Abstract A*, the start and goal rooms are the last two nodes
+    std::vector<std::uint32_t> parents;
+    std::vector<std::uint32_t> stamps;          // Query that last touched a node (g and parents are not cleared)
+    std::uint32_t stamp;
+    std::vector<open_entry> open;
+}hpa_query;
+
+// Abstract route: the rooms where it changes clusters, refined leg by leg (refine_leg) when needed
+typedef struct hpa_path {
+    long long length;                   // -1 when there is no route
+    std::vector<maze_cell> waypoints;   // Start, the nodes passed and the goal
+}hpa_path;
+
+
+// Hash of what the routes depend on: the walls and the wall / elevator types (FNV-1a over 8 rooms at a time,
+// in room id order whatever the layout)
+inline std::uint64_t maze_route_hash(const maze_grid &grid) {
+    std::uint64_t hash = 0xcbf29ce484222325ull;
+    const std::uint64_t low_bits = 0x0303030303030303ull, first_bits = 0x0101010101010101ull;
+    std::vector<std::uint8_t> row((grid.width + 7) / 8 * 8, 0);
+    for (int layer = 0; layer < grid.layers; ++layer) {
+        for (int r = 0; r < grid.height; ++r) {
+            if (grid.tile_shift == LAYOUT_ROW_MAJOR && !grid.cells.paged())
+                std::memcpy(row.data(), grid.cells.data() + grid_index(grid, layer, 0, r), grid.width);
+            else
+                for (int c = 0; c < grid.width; ++c)
+                    row[c] = grid.cells[grid_index(grid, layer, c, r)];
+            for (std::size_t k = 0; k < row.size(); k += 8) {
+                std::uint64_t word;
+                std::memcpy(&word, &row[k], 8);
+                // Types above 3 (and the start, 0xF) read as 0: a byte keeps its low nibble when bits 2 and 3 are clear
+                std::uint64_t high = (word >> 2) & low_bits;
+                std::uint64_t cleared = ((high | high >> 1) & first_bits) * 0x0F;
+                hash = (hash ^ (word & ~cleared)) * 0x100000001b3ull;
+            }
+        }
+    }
+    return hash ^ ((std::uint64_t)grid.width << 40 ^ (std::uint64_t)grid.height << 16 ^ (std::uint64_t)grid.layers);
+}
+
+
+inline int room_cluster(const cluster_graph &graph, std::uint64_t id) {
+    std::uint64_t row_id = id / graph.width;
+    int column = (int)(id - row_id * graph.width);
+    int layer = (int)(row_id / graph.height);
+    int row = (int)(row_id - (std::uint64_t)layer * graph.height);
+    return (layer * graph.cluster_rows + row / graph.cluster_size) * graph.cluster_columns + column / graph.cluster_size;
+}
+
+// Node of a room, -1 when the room is no node
+inline long long room_node(const cluster_graph &graph, std::uint64_t id) {
+    int cluster = room_cluster(graph, id);
+    std::vector<std::uint64_t>::const_iterator first = graph.node_rooms.begin() + graph.cluster_nodes[cluster];
+    std::vector<std::uint64_t>::const_iterator last = first + graph.cluster_node_counts[cluster];
+    std::vector<std::uint64_t>::const_iterator found = std::lower_bound(first, last, id);
+    return found != last && *found == id ? (long long)(found - graph.node_rooms.begin()) : -1;
+}
+
+
+// Breadth-first search from a room, inside its cluster only (distances of the cluster rooms)
+inline void cluster_bfs(const cluster_graph &graph, const maze_grid &grid, cluster_search &search, std::uint64_t from) {
+    maze_cell start = room_cell(grid, from);
+    search.layer = start.layer;
+    search.column = start.column / graph.cluster_size * graph.cluster_size;
+    search.row = start.row / graph.cluster_size * graph.cluster_size;
+    search.columns = std::min(graph.cluster_size, graph.width - search.column);
+    search.rows = std::min(graph.cluster_size, graph.height - search.row);
+    search.distances.assign((std::size_t)graph.cluster_size * graph.cluster_size, -1);
+    search.moves.resize(search.distances.size());
+    search.queue.clear();
+
+    std::uint64_t origin = room_id(grid, {search.layer, search.column, search.row});
+    int first = (start.row - search.row) * graph.cluster_size + start.column - search.column;
+    search.distances[first] = 0;
+    search.queue.push_back(first);
+    std::uint64_t ids[6];
+    std::uint8_t moves[6];
+    for (std::size_t k = 0; k < search.queue.size(); ++k) {
+        int local = search.queue[k];
+        int row = local / graph.cluster_size, column = local - row * graph.cluster_size;
+        std::uint64_t id = origin + (std::uint64_t)row * grid.width + column;
+        int count = room_neighbours(grid, id, ids, moves);
+        for (int n = 0; n < count; ++n) {
+            if (moves[n] >= MOVE_UP)
+                continue;
+            maze_cell next = moved_cell({search.layer, column, row}, moves[n]);
+            if (next.column < 0 || next.column >= search.columns || next.row < 0 || next.row >= search.rows)
+                continue;
+            int target = next.row * graph.cluster_size + next.column;
+            if (search.distances[target] >= 0)
+                continue;
+            search.distances[target] = search.distances[local] + 1;
+            search.moves[target] = moves[n];
+            search.queue.push_back(target);
+        }
+    }
+}
+
+// Distance of a room from the start of the last cluster_bfs (-1 when not reached or outside the cluster)
+inline int cluster_distance(const cluster_graph &graph, const maze_grid &grid, const cluster_search &search, std::uint64_t id) {
+    maze_cell cell = room_cell(grid, id);
+    if (cell.layer != search.layer || cell.column < search.column || cell.column >= search.column + search.columns || cell.row < search.row || cell.row >= search.row + search.rows)
+        return -1;
+    return search.distances[(cell.row - search.row) * graph.cluster_size + cell.column - search.column];
+}
+
+
+// First room and size of a cluster
+inline void cluster_box(const cluster_graph &graph, int cluster, int &layer, int &column, int &row, int &columns, int &rows) {
+    int layer_clusters = graph.cluster_columns * graph.cluster_rows;
+    layer = cluster / layer_clusters;
+    column = cluster % graph.cluster_columns * graph.cluster_size;
+    row = cluster % layer_clusters / graph.cluster_columns * graph.cluster_size;
+    columns = std::min(graph.cluster_size, graph.width - column);
+    rows = std::min(graph.cluster_size, graph.height - row);
+}
+
+
+// Open crossings of one cluster border, one per run of open sides (its middle), both ways: the rooms of column
+// (vertical) or row border, rows (columns) [begin, end), and the rooms after them
+inline void border_runs(const maze_grid &grid, int layer, bool vertical, int border, int begin, int end, std::vector<std::pair<std::uint64_t, std::uint64_t> > &links) {
+    int side = vertical ? WALL_RIGHT : WALL_FRONT, run = 0;
+    for (int k = begin; k <= end; ++k) {
+        if (k < end && !(cell_walls(grid, layer, vertical ? border : k, vertical ? k : border) & side)) {
+            ++run;
+            continue;
+        }
+        if (run > 0) {
+            int middle = k - run + (run - 1) / 2;
+            std::uint64_t near = room_id(grid, vertical ? maze_cell{layer, border, middle} : maze_cell{layer, middle, border});
+            std::uint64_t far = vertical ? near + 1 : near + grid.width;
+            links.push_back(std::make_pair(near, far));
+            links.push_back(std::make_pair(far, near));
+        }
+        run = 0;
+    }
+}
+
+// Moves between clusters that start or end in a cluster: the crossings of its borders and the elevators out of
+// and into its rooms
+inline void cluster_links(const cluster_graph &graph, const maze_grid &grid, int cluster, std::vector<std::pair<std::uint64_t, std::uint64_t> > &links) {
+    int layer, column, row, columns, rows;
+    cluster_box(graph, cluster, layer, column, row, columns, rows);
+    if (column > 0)
+        border_runs(grid, layer, true, column - 1, row, row + rows, links);
+    if (column + columns < grid.width)
+        border_runs(grid, layer, true, column + columns - 1, row, row + rows, links);
+    if (row > 0)
+        border_runs(grid, layer, false, row - 1, column, column + columns, links);
+    if (row + rows < grid.height)
+        border_runs(grid, layer, false, row + rows - 1, column, column + columns, links);
+
+    std::uint64_t layer_rooms = (std::uint64_t)grid.width * grid.height;
+    for (int r = row; r < row + rows; ++r) {
+        for (int c = column; c < column + columns; ++c) {
+            std::uint64_t id = room_id(grid, {layer, c, r});
+            int type = cell_type_of(room_byte(grid, id));
+            if (type == 1)
+                continue;
+            bool above = layer + 1 < grid.layers, below = layer > 0;
+            int type_above = above ? cell_type_of(room_byte(grid, id + layer_rooms)) : 1;
+            int type_below = below ? cell_type_of(room_byte(grid, id - layer_rooms)) : 1;
+            if (type == 2 && above && type_above != 1)
+                links.push_back(std::make_pair(id, id + layer_rooms));
+            if (type == 3 && below && type_below != 1)
+                links.push_back(std::make_pair(id, id - layer_rooms));
+            if (type_above == 3)
+                links.push_back(std::make_pair(id + layer_rooms, id));
+            if (type_below == 2)
+                links.push_back(std::make_pair(id - layer_rooms, id));
+        }
+    }
+}
+
+
+// Edges out of the nodes of one cluster (every cluster numbered): the other nodes of the cluster each one reaches
+// inside it (a BFS from every node), then its links to the other clusters, taken from links (sorted)
+inline void search_cluster(const cluster_graph &graph, const maze_grid &grid, cluster_search &search, int cluster, const std::vector<std::pair<std::uint64_t, std::uint64_t> > &links, cluster_edges &edges) {
+    std::uint32_t first = graph.cluster_nodes[cluster], last = first + graph.cluster_node_counts[cluster];
+    edges.counts.assign(last - first, 0);
+    edges.targets.clear();
+    edges.costs.clear();
+    std::vector<std::uint32_t> targets;
+    for (std::uint32_t a = first; a < last; ++a) {
+        std::size_t begin = edges.targets.size();
+        std::uint64_t room = graph.node_rooms[a];
+        if (last - first > 1) {
+            cluster_bfs(graph, grid, search, room);
+            for (std::uint32_t b = first; b < last; ++b) {
+                // Nodes that cannot reach each other inside a cluster have no edge
+                int distance = b == a ? -1 : cluster_distance(graph, grid, search, graph.node_rooms[b]);
+                if (distance < 0)
+                    continue;
+                edges.targets.push_back(b);
+                edges.costs.push_back((std::uint32_t)distance);
+            }
+        }
+        targets.clear();
+        std::vector<std::pair<std::uint64_t, std::uint64_t> >::const_iterator link = std::lower_bound(links.begin(), links.end(), std::make_pair(room, (std::uint64_t)0));
+        for (; link != links.end() && link->first == room; ++link)
+            targets.push_back((std::uint32_t)room_node(graph, link->second));
+        std::sort(targets.begin(), targets.end());
+        edges.targets.insert(edges.targets.end(), targets.begin(), targets.end());
+        edges.costs.insert(edges.costs.end(), targets.size(), 1);
+        edges.counts[a - first] = (std::uint32_t)(edges.targets.size() - begin);
+    }
+}
+
+// Writing the edges of a cluster from edge begin on (the edge arrays are large enough)
+inline void place_cluster_edges(cluster_graph &graph, int cluster, const cluster_edges &edges, std::uint64_t begin) {
+    std::copy(edges.targets.begin(), edges.targets.end(), graph.edge_targets.begin() + begin);
+    std::copy(edges.costs.begin(), edges.costs.end(), graph.edge_costs.begin() + begin);
+    for (std::size_t k = 0; k < edges.counts.size(); ++k) {
+        std::uint32_t node = graph.cluster_nodes[cluster] + (std::uint32_t)k;
+        graph.edge_offsets[node] = begin;
+        graph.edge_counts[node] = edges.counts[k];
+        begin += edges.counts[k];
+    }
+}
+
+
+// Building the cluster graph of a maze (the clusters are searched on the pool threads when one is given)
+inline void build_cluster_graph(cluster_graph &graph, const maze_model &maze, int cluster_size = CLUSTER_SIZE, ThreadPool *pool = nullptr) {
+    const maze_grid &grid = maze.grid;
+    graph.width = grid.width;
+    graph.height = grid.height;
+    graph.layers = grid.layers;
+    graph.cluster_size = cluster_size;
+    graph.cluster_columns = (grid.width + cluster_size - 1) / cluster_size;
+    graph.cluster_rows = (grid.height + cluster_size - 1) / cluster_size;
+    graph.maze_hash = maze_route_hash(grid);
+    int clusters = graph.cluster_columns * graph.cluster_rows * grid.layers;
+
+    // Every crossing and elevator is found from both of its clusters
+    std::vector<std::pair<std::uint64_t, std::uint64_t> > links;
+    for (int c = 0; c < clusters; ++c)
+        cluster_links(graph, grid, c, links);
+    std::sort(links.begin(), links.end());
+    links.erase(std::unique(links.begin(), links.end()), links.end());
+
+    // Nodes: both ends of every link, grouped by cluster
+    std::vector<std::pair<int, std::uint64_t> > ends;
+    ends.reserve(links.size() * 2);
+    for (std::size_t k = 0; k < links.size(); ++k) {
+        ends.push_back(std::make_pair(room_cluster(graph, links[k].first), links[k].first));
+        ends.push_back(std::make_pair(room_cluster(graph, links[k].second), links[k].second));
+    }
+    std::sort(ends.begin(), ends.end());
+    ends.erase(std::unique(ends.begin(), ends.end()), ends.end());
+    graph.node_rooms.resize(ends.size());
+    graph.cluster_nodes.assign(clusters, 0);
+    graph.cluster_node_counts.assign(clusters, 0);
+    for (std::size_t n = 0; n < ends.size(); ++n) {
+        graph.node_rooms[n] = ends[n].second;
+        ++graph.cluster_node_counts[ends[n].first];
+    }
+    for (int c = 1; c < clusters; ++c)
+        graph.cluster_nodes[c] = graph.cluster_nodes[c - 1] + graph.cluster_node_counts[c - 1];
+
+    // Edges of every cluster, then laid out in cluster order
+    std::vector<cluster_edges> edges(clusters);
+    std::function<void(int, int)> search_clusters = [&](int begin, int end) {
+        cluster_search search;
+        for (int c = begin; c < end; ++c)
+            search_cluster(graph, grid, search, c, links, edges[c]);
+    };
+    // Paged grids are read through a cache that is not thread-safe
+    if (pool && !grid.cells.paged())
+        pool->parallel_for(clusters, 16, search_clusters);
+    else
+        search_clusters(0, clusters);
+
+    std::uint64_t total = 0;
+    for (int c = 0; c < clusters; ++c)
+        total += edges[c].targets.size();
+    graph.edge_offsets.resize(ends.size());
+    graph.edge_counts.resize(ends.size());
+    graph.edge_targets.resize(total);
+    graph.edge_costs.resize(total);
+    total = 0;
+    for (int c = 0; c < clusters; ++c) {
+        place_cluster_edges(graph, c, edges[c], total);
+        total += edges[c].targets.size();
+        std::vector<std::uint32_t>().swap(edges[c].counts);
+        std::vector<std::uint32_t>().swap(edges[c].targets);
+        std::vector<std::uint32_t>().swap(edges[c].costs);
+    }
+    graph.unused_nodes = 0;
+    graph.unused_edges = 0;
+}
+
+
+// Dropping the slots update_cluster_graph left behind: the nodes numbered again cluster after cluster and their
+// edges copied in node order (the layout of build_cluster_graph)
+inline void compact_cluster_graph(cluster_graph &graph) {
+    int clusters = graph.cluster_columns * graph.cluster_rows * graph.layers;
+    std::vector<std::uint32_t> numbers(graph.node_rooms.size(), 0);
+    std::uint32_t nodes = 0;
+    for (int c = 0; c < clusters; ++c)
+        for (std::uint32_t k = 0; k < graph.cluster_node_counts[c]; ++k)
+            numbers[graph.cluster_nodes[c] + k] = nodes++;
+
+    std::vector<std::uint64_t> node_rooms(nodes), edge_offsets(nodes);
+    std::vector<std::uint32_t> edge_counts(nodes), edge_targets, edge_costs;
+    edge_targets.reserve(graph.edge_targets.size() - graph.unused_edges);
+    edge_costs.reserve(edge_targets.capacity());
+    for (int c = 0, n = 0; c < clusters; ++c) {
+        for (std::uint32_t k = 0; k < graph.cluster_node_counts[c]; ++k, ++n) {
+            std::uint32_t old = graph.cluster_nodes[c] + k;
+            std::uint64_t first = graph.edge_offsets[old], last = first + graph.edge_counts[old];
+            node_rooms[n] = graph.node_rooms[old];
+            edge_offsets[n] = edge_targets.size();
+            edge_counts[n] = graph.edge_counts[old];
+            for (std::uint64_t e = first; e < last; ++e) {
+                edge_targets.push_back(numbers[graph.edge_targets[e]]);
+                edge_costs.push_back(graph.edge_costs[e]);
+            }
+        }
+        graph.cluster_nodes[c] = n - graph.cluster_node_counts[c];
+    }
+    graph.node_rooms.swap(node_rooms);
+    graph.edge_offsets.swap(edge_offsets);
+    graph.edge_counts.swap(edge_counts);
+    graph.edge_targets.swap(edge_targets);
+    graph.edge_costs.swap(edge_costs);
+    graph.unused_nodes = 0;
+    graph.unused_edges = 0;
+}
+
+
+// Bringing the cluster graph up to date after a room was edited (edit_room): the clusters of the room and of its
+// neighbours (their crossings and the distances inside them), and the clusters above and below (its elevators)
+// are searched again, the others are left as they are. The nodes and edges of a searched cluster are written over
+// its previous ones when they fit, at the end of the arrays otherwise; the links of the clusters around it are
+// pointed at its new nodes. The graph no longer hashes as the maze file it was built from (maze_hash is 0)
+inline void update_cluster_graph(cluster_graph &graph, const maze_model &maze, int layer, int column, int row, ThreadPool *pool = nullptr) {
+    const maze_grid &grid = maze.grid;
+    int layer_clusters = graph.cluster_columns * graph.cluster_rows;
+    std::vector<int> searched;
+    const int columns[5] = {0, -1, 1, 0, 0};
+    const int rows[5] = {0, 0, 0, -1, 1};
+    for (int k = 0; k < 5; ++k)
+        if (inside_grid(grid, layer, column + columns[k], row + rows[k]))
+            searched.push_back(room_cluster(graph, room_id(grid, {layer, column + columns[k], row + rows[k]})));
+    for (int l = std::max(layer - 1, 0); l <= std::min(layer + 1, grid.layers - 1); ++l)
+        searched.push_back(room_cluster(graph, room_id(grid, {l, column, row})));
+    std::sort(searched.begin(), searched.end());
+    searched.erase(std::unique(searched.begin(), searched.end()), searched.end());
+
+    // Links only join neighbouring clusters: the ones of the clusters around the searched ones that lead into them
+    // are kept by room while the nodes there are numbered again
+    std::vector<int> around;
+    for (std::size_t k = 0; k < searched.size(); ++k) {
+        int c = searched[k], l = c / layer_clusters, x = c % graph.cluster_columns, y = c % layer_clusters / graph.cluster_columns;
+        if (x > 0)
+            around.push_back(c - 1);
+        if (x + 1 < graph.cluster_columns)
+            around.push_back(c + 1);
+        if (y > 0)
+            around.push_back(c - graph.cluster_columns);
+        if (y + 1 < graph.cluster_rows)
+            around.push_back(c + graph.cluster_columns);
+        if (l > 0)
+            around.push_back(c - layer_clusters);
+        if (l + 1 < graph.layers)
+            around.push_back(c + layer_clusters);
+    }
+    std::sort(around.begin(), around.end());
+    around.erase(std::unique(around.begin(), around.end()), around.end());
+    std::vector<std::pair<std::uint64_t, std::uint64_t> > entries;  // Edge, room it leads to
+    for (std::size_t k = 0; k < around.size(); ++k) {
+        int c = around[k];
+        if (std::binary_search(searched.begin(), searched.end(), c))
+            continue;
+        for (std::uint32_t n = graph.cluster_nodes[c]; n < graph.cluster_nodes[c] + graph.cluster_node_counts[c]; ++n) {
+            for (std::uint64_t e = graph.edge_offsets[n]; e < graph.edge_offsets[n] + graph.edge_counts[n]; ++e) {
+                std::uint64_t target = graph.node_rooms[graph.edge_targets[e]];
+                if (std::binary_search(searched.begin(), searched.end(), room_cluster(graph, target)))
+                    entries.push_back(std::make_pair(e, target));
+            }
+        }
+    }
+
+    // Nodes of the searched clusters: the ends of their links found again, over the previous ones when they fit
+    std::vector<std::vector<std::pair<std::uint64_t, std::uint64_t> > > links(searched.size());
+    std::vector<std::uint64_t> edge_first(searched.size(), 0), edge_space(searched.size(), 0);
+    std::vector<std::uint64_t> rooms;
+    for (std::size_t k = 0; k < searched.size(); ++k) {
+        int c = searched[k];
+        std::uint32_t first = graph.cluster_nodes[c], count = graph.cluster_node_counts[c];
+        if (count > 0)
+            edge_first[k] = graph.edge_offsets[first];
+        for (std::uint32_t n = first; n < first + count; ++n)
+            edge_space[k] += graph.edge_counts[n];
+
+        cluster_links(graph, grid, c, links[k]);
+        std::sort(links[k].begin(), links[k].end());
+        links[k].erase(std::unique(links[k].begin(), links[k].end()), links[k].end());
+        rooms.clear();
+        for (std::size_t l = 0; l < links[k].size(); ++l) {
+            if (room_cluster(graph, links[k][l].first) == c)
+                rooms.push_back(links[k][l].first);
+            if (room_cluster(graph, links[k][l].second) == c)
+                rooms.push_back(links[k][l].second);
+        }
+        std::sort(rooms.begin(), rooms.end());
+        rooms.erase(std::unique(rooms.begin(), rooms.end()), rooms.end());
+        if (rooms.size() > count) {
+            graph.unused_nodes += count;
+            first = (std::uint32_t)graph.node_rooms.size();
+            graph.node_rooms.resize(first + rooms.size());
+            graph.edge_offsets.resize(graph.node_rooms.size());
+            graph.edge_counts.resize(graph.node_rooms.size());
+        }
+        else
+            graph.unused_nodes += count - rooms.size();
+        std::copy(rooms.begin(), rooms.end(), graph.node_rooms.begin() + first);
+        graph.cluster_nodes[c] = first;
+        graph.cluster_node_counts[c] = (std::uint32_t)rooms.size();
+    }
+
+    // Their edges, over the previous ones when they fit
+    std::vector<cluster_edges> edges(searched.size());
+    std::function<void(int, int)> search_clusters = [&](int begin, int end) {
+        cluster_search search;
+        for (int k = begin; k < end; ++k)
+            search_cluster(graph, grid, search, searched[k], links[k], edges[k]);
+    };
+    // Paged grids are read through a cache that is not thread-safe
+    if (pool && !grid.cells.paged())
+        pool->parallel_for((int)searched.size(), 1, search_clusters);
+    else
+        search_clusters(0, (int)searched.size());
+    for (std::size_t k = 0; k < searched.size(); ++k) {
+        std::uint64_t count = edges[k].targets.size(), first = edge_first[k];
+        if (count > edge_space[k]) {
+            graph.unused_edges += edge_space[k];
+            first = graph.edge_targets.size();
+            graph.edge_targets.resize(first + count);
+            graph.edge_costs.resize(first + count);
+        }
+        else
+            graph.unused_edges += edge_space[k] - count;
+        place_cluster_edges(graph, searched[k], edges[k], first);
+    }
+    for (std::size_t k = 0; k < entries.size(); ++k)
+        graph.edge_targets[entries[k].first] = (std::uint32_t)room_node(graph, entries[k].second);
+    graph.maze_hash = 0;
+
+    if (graph.unused_nodes * 2 > graph.node_rooms.size() || graph.unused_edges * 2 > graph.edge_targets.size())
+        compact_cluster_graph(graph);
+}
+
+
+// Shortest route between two rooms on the abstract graph (length -1 when there is none): the start and goal rooms
+// are linked to the nodes of their clusters (and to each other when they share one) by a BFS inside the cluster.
+// The heuristic of astar_search stays consistent (no edge is shorter than the moves it skips)
+inline hpa_path hpa_search(const cluster_graph &graph, const maze_model &maze, hpa_query &query, const maze_cell &from, const maze_cell &to) {
+    const maze_grid &grid = maze.grid;
+    hpa_path path;
+    path.length = -1;
+    if (!walkable(grid, from) || !walkable(grid, to))
+        return path;
+
+    std::uint32_t nodes = (std::uint32_t)graph.node_rooms.size(), start = nodes, goal = nodes + 1;
+    if (query.g.size() != (std::size_t)nodes + 2) {
+        query.g.assign(nodes + 2, 0);
+        query.parents.assign(nodes + 2, 0);
+        query.stamps.assign(nodes + 2, 0);
+        query.stamp = 0;
+    }
+    if (++query.stamp == 0) {
+        std::fill(query.stamps.begin(), query.stamps.end(), 0);
+        query.stamp = 1;
+    }
+
+    // Moves inside a layer are symmetric, the BFS from the goal gives the distances to it
+    std::uint64_t from_id = room_id(grid, from), to_id = room_id(grid, to);
+    int from_cluster = room_cluster(graph, from_id), to_cluster = room_cluster(graph, to_id);
+    std::uint32_t goal_first = graph.cluster_nodes[to_cluster], goal_count = graph.cluster_node_counts[to_cluster];
+    cluster_bfs(graph, grid, query.local, to_id);
+    query.goal_costs.resize(goal_count);
+    for (std::uint32_t k = 0; k < goal_count; ++k) {
+        int distance = cluster_distance(graph, grid, query.local, graph.node_rooms[goal_first + k]);
+        query.goal_costs[k] = distance < 0 ? CLUSTER_UNREACHABLE : (std::uint32_t)distance;
+    }
+    std::uint32_t start_first = graph.cluster_nodes[from_cluster], start_count = graph.cluster_node_counts[from_cluster];
+    cluster_bfs(graph, grid, query.local, from_id);
+    int direct = cluster_distance(graph, grid, query.local, to_id);
+    query.start_costs.resize(start_count);
+    for (std::uint32_t k = 0; k < start_count; ++k) {
+        int distance = cluster_distance(graph, grid, query.local, graph.node_rooms[start_first + k]);
+        query.start_costs[k] = distance < 0 ? CLUSTER_UNREACHABLE : (std::uint32_t)distance;
+    }
+
+    std::vector<open_entry> &open = query.open;
+    open.clear();
+    auto relax = [&](std::uint32_t node, std::uint32_t g, std::uint32_t parent) {
+        if (query.stamps[node] == query.stamp && query.g[node] <= g)
+            return;
+        query.stamps[node] = query.stamp;
+        query.g[node] = g;
+        query.parents[node] = parent;
+        std::uint32_t h = node >= start ? (node == start ? path_heuristic(from, to) : 0) : path_heuristic(room_cell(grid, graph.node_rooms[node]), to);
+        open_entry entry = {g + h, h, node};
+        open.push_back(entry);
+        std::push_heap(open.begin(), open.end(), open_after);
+    };
+    relax(start, 0, start);
+
+    while (!open.empty()) {
+        std::pop_heap(open.begin(), open.end(), open_after);
+        open_entry entry = open.back();
+        open.pop_back();
+        std::uint32_t node = (std::uint32_t)entry.room, g = entry.f - entry.h;
+        if (g > query.g[node])
+            continue;
+        if (node == goal)
+            break;
+        if (node == start) {
+            if (direct >= 0)
+                relax(goal, (std::uint32_t)direct, start);
+            for (std::uint32_t k = 0; k < start_count; ++k)
+                if (query.start_costs[k] != CLUSTER_UNREACHABLE)
+                    relax(start_first + k, query.start_costs[k], start);
+            continue;
+        }
+        for (std::uint64_t e = graph.edge_offsets[node]; e < graph.edge_offsets[node] + graph.edge_counts[node]; ++e)
+            relax(graph.edge_targets[e], g + graph.edge_costs[e], node);
+        if (node - goal_first < goal_count && query.goal_costs[node - goal_first] != CLUSTER_UNREACHABLE)
+            relax(goal, g + query.goal_costs[node - goal_first], node);
+    }
+    if (query.stamps[goal] != query.stamp)
+        return path;
+
+    // Waypoints from the goal back to the start (a start or goal room that is a node too is kept once)
+    path.length = query.g[goal];
+    for (std::uint32_t node = goal;; node = query.parents[node]) {
+        maze_cell cell = node == goal ? to : node == start ? from : room_cell(grid, graph.node_rooms[node]);
+        if (path.waypoints.empty() || room_id(grid, path.waypoints.back()) != room_id(grid, cell))
+            path.waypoints.push_back(cell);
+        if (node == start)
+            break;
+    }
+    std::reverse(path.waypoints.begin(), path.waypoints.end());
+    return path;
+}
+
+
+// Rooms of one leg of an abstract route (from waypoint leg to the next one, both included): a crossing or an
+// elevator is one move, other legs are found by a BFS inside their cluster. False when the maze changed since
+inline bool refine_leg(const cluster_graph &graph, const maze_model &maze, cluster_search &search, const hpa_path &path, std::size_t leg, std::vector<maze_cell> &cells) {
+    const maze_grid &grid = maze.grid;
+    const maze_cell &from = path.waypoints[leg], &to = path.waypoints[leg + 1];
+    std::uint64_t from_id = room_id(grid, from), to_id = room_id(grid, to);
+    cells.clear();
+    if (from.layer != to.layer || room_cluster(graph, from_id) != room_cluster(graph, to_id)) {
+        cells.push_back(from);
+        cells.push_back(to);
+        return path_heuristic(from, to) == 1;
+    }
+
+    cluster_bfs(graph, grid, search, from_id);
+    if (cluster_distance(graph, grid, search, to_id) < 0)
+        return false;
+    int column = to.column - search.column, row = to.row - search.row;
+    for (;;) {
+        cells.push_back({search.layer, search.column + column, search.row + row});
+        int local = row * graph.cluster_size + column;
+        if (search.distances[local] == 0)
+            break;
+        switch (search.moves[local]) {
+            case MOVE_LEFT: ++column; break;
+            case MOVE_RIGHT: --column; break;
+            case MOVE_BACK: ++row; break;
+            default: --row; break;
+        }
+    }
+    std::reverse(cells.begin(), cells.end());
+    return true;
+}
+
+// Every room of an abstract route, leg after leg
+inline bool refine_path(const cluster_graph &graph, const maze_model &maze, cluster_search &search, const hpa_path &path, std::vector<maze_cell> &cells) {
+    cells.clear();
+    if (path.length < 0)
+        return false;
+    cells.push_back(path.waypoints[0]);
+    std::vector<maze_cell> leg;
+    for (std::size_t k = 0; k + 1 < path.waypoints.size(); ++k) {
+        if (!refine_leg(graph, maze, search, path, k, leg))
+            return false;
+        cells.insert(cells.end(), leg.begin() + 1, leg.end());
+    }
+    return true;
+}
+
+
+// Cache file of the cluster graph of a maze file, next to it
+inline std::string cluster_graph_file(const char *maze_file) {
+    return std::string(maze_file) + ".clusters";
+}
+
+// Writing a cluster graph (compacted first when it was updated): header, then the node rooms, the first node and
+// node count of every cluster, the first edge and edge count of every node, the edge targets and edge costs
+inline bool save_cluster_graph(const cluster_graph &graph, const char *file_name) {
+    if (graph.unused_nodes > 0 || graph.unused_edges > 0) {
+        cluster_graph compacted = graph;
+        compact_cluster_graph(compacted);
+        return save_cluster_graph(compacted, file_name);
+    }
+    std::ofstream file(file_name, std::ios::binary | std::ios::trunc);
+    if (!file)
+        return false;
+    cluster_graph_header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, CLUSTER_GRAPH_MAGIC, sizeof(header.magic));
+    header.version = CLUSTER_GRAPH_VERSION;
+    header.byte_order = CLUSTER_GRAPH_BYTE_ORDER;
+    header.width = graph.width;
+    header.height = graph.height;
+    header.layers = graph.layers;
+    header.cluster_size = graph.cluster_size;
+    header.maze_hash = graph.maze_hash;
+    header.nodes = graph.node_rooms.size();
+    header.edges = graph.edge_targets.size();
+    file.write((const char*)&header, sizeof(header));
+    file.write((const char*)graph.node_rooms.data(), graph.node_rooms.size() * sizeof(std::uint64_t));
+    file.write((const char*)graph.cluster_nodes.data(), graph.cluster_nodes.size() * sizeof(std::uint32_t));
+    file.write((const char*)graph.cluster_node_counts.data(), graph.cluster_node_counts.size() * sizeof(std::uint32_t));
+    file.write((const char*)graph.edge_offsets.data(), graph.edge_offsets.size() * sizeof(std::uint64_t));
+    file.write((const char*)graph.edge_counts.data(), graph.edge_counts.size() * sizeof(std::uint32_t));
+    file.write((const char*)graph.edge_targets.data(), graph.edge_targets.size() * sizeof(std::uint32_t));
+    file.write((const char*)graph.edge_costs.data(), graph.edge_costs.size() * sizeof(std::uint32_t));
+    return (bool)file;
+}
+
+// Checking a cluster graph read from a file before it is used: the nodes of every cluster and the edges of every
+// node follow each other (saved compacted), the nodes of a cluster are rooms of that cluster in increasing order,
+// and every edge leads to a node at a cost a route can have (one move, up to a cluster of rooms inside one)
+inline bool valid_cluster_graph(const cluster_graph &graph) {
+    std::uint64_t rooms = (std::uint64_t)graph.width * graph.height * graph.layers, nodes = 0, edges = 0;
+    std::uint64_t longest = (std::uint64_t)graph.cluster_size * graph.cluster_size;
+    for (std::size_t c = 0; c < graph.cluster_nodes.size(); ++c) {
+        if (graph.cluster_nodes[c] != nodes || graph.cluster_node_counts[c] > graph.node_rooms.size() - nodes)
+            return false;
+        for (std::uint32_t k = 0; k < graph.cluster_node_counts[c]; ++k, ++nodes) {
+            std::uint64_t room = graph.node_rooms[nodes];
+            if (room >= rooms || room_cluster(graph, room) != (int)c || (k > 0 && room <= graph.node_rooms[nodes - 1]))
+                return false;
+            if (graph.edge_offsets[nodes] != edges || graph.edge_counts[nodes] > graph.edge_targets.size() - edges)
+                return false;
+            for (std::uint32_t e = 0; e < graph.edge_counts[nodes]; ++e, ++edges)
+                if (graph.edge_targets[edges] >= graph.node_rooms.size() || graph.edge_costs[edges] == 0 || graph.edge_costs[edges] > longest)
+                    return false;
+        }
+    }
+    return nodes == graph.node_rooms.size() && edges == graph.edge_targets.size();
+}
+
+// Reading a cluster graph written by save_cluster_graph for the given grid and cluster size. The counts in the
+// header are checked against the file size before anything is allocated, and the graph is checked after it is
+// read (valid_cluster_graph): false on any mismatch, the graph is then built again
+inline bool load_cluster_graph(cluster_graph &graph, const char *file_name, const maze_grid &grid, int cluster_size) {
+    std::ifstream file(file_name, std::ios::binary | std::ios::ate);
+    if (!file)
+        return false;
+    std::uint64_t size = (std::uint64_t)file.tellg();
+    file.seekg(0);
+    cluster_graph_header header;
+    if (size < sizeof(header) || !file.read((char*)&header, sizeof(header)))
+        return false;
+    if (std::memcmp(header.magic, CLUSTER_GRAPH_MAGIC, sizeof(header.magic)) != 0 || header.version != CLUSTER_GRAPH_VERSION || header.byte_order != CLUSTER_GRAPH_BYTE_ORDER)
+        return false;
+    if (cluster_size <= 0 || header.cluster_size != (std::uint32_t)cluster_size || header.width != (std::uint32_t)grid.width || header.height != (std::uint32_t)grid.height || header.layers != (std::uint32_t)grid.layers)
+        return false;
+    graph.width = grid.width;
+    graph.height = grid.height;
+    graph.layers = grid.layers;
+    graph.cluster_size = cluster_size;
+    graph.cluster_columns = (graph.width + graph.cluster_size - 1) / graph.cluster_size;
+    graph.cluster_rows = (graph.height + graph.cluster_size - 1) / graph.cluster_size;
+    graph.maze_hash = header.maze_hash;
+
+    // Node ids are 32 bits, every node is a room; the file holds exactly the arrays the counts give
+    std::uint64_t clusters = (std::uint64_t)graph.cluster_columns * graph.cluster_rows * graph.layers;
+    std::uint64_t payload = size - sizeof(header);
+    if (header.nodes >= CLUSTER_UNREACHABLE || header.nodes > (std::uint64_t)grid.width * grid.height * grid.layers || header.edges > payload / 8)
+        return false;
+    if (payload != header.nodes * 20 + clusters * 8 + header.edges * 8)
+        return false;
+    graph.node_rooms.resize(header.nodes);
+    graph.cluster_nodes.resize(clusters);
+    graph.cluster_node_counts.resize(clusters);
+    graph.edge_offsets.resize(header.nodes);
+    graph.edge_counts.resize(header.nodes);
+    graph.edge_targets.resize(header.edges);
+    graph.edge_costs.resize(header.edges);
+    file.read((char*)graph.node_rooms.data(), graph.node_rooms.size() * sizeof(std::uint64_t));
+    file.read((char*)graph.cluster_nodes.data(), graph.cluster_nodes.size() * sizeof(std::uint32_t));
+    file.read((char*)graph.cluster_node_counts.data(), graph.cluster_node_counts.size() * sizeof(std::uint32_t));
+    file.read((char*)graph.edge_offsets.data(), graph.edge_offsets.size() * sizeof(std::uint64_t));
+    file.read((char*)graph.edge_counts.data(), graph.edge_counts.size() * sizeof(std::uint32_t));
+    file.read((char*)graph.edge_targets.data(), graph.edge_targets.size() * sizeof(std::uint32_t));
+    file.read((char*)graph.edge_costs.data(), graph.edge_costs.size() * sizeof(std::uint32_t));
+    graph.unused_nodes = 0;
+    graph.unused_edges = 0;
+    return (bool)file && valid_cluster_graph(graph);
+}
+
+// Cluster graph of a maze file: loaded from its cache file when that was built for the same maze and cluster
+// size, otherwise built and cached. Returns whether it was loaded
+inline bool cached_cluster_graph(cluster_graph &graph, const maze_model &maze, const char *maze_file, int cluster_size = CLUSTER_SIZE, ThreadPool *pool = nullptr) {
+    std::string file_name = cluster_graph_file(maze_file);
+    if (load_cluster_graph(graph, file_name.c_str(), maze.grid, cluster_size) && graph.maze_hash == maze_route_hash(maze.grid))
+        return true;
+    build_cluster_graph(graph, maze, cluster_size, pool);
+    save_cluster_graph(graph, file_name.c_str());
+    return false;
+}
+#endif
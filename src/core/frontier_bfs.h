@@ -0,0 +1,329 @@
+#ifndef FRONTIER_BFS_H
+#define FRONTIER_BFS_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "pathfinding.h"
+
+
+// Breadth-first search on bitmasks: every layer is split in blocks of 8x8 rooms, one 64-bit word per block
+// (bit r * 8 + c is the room of column c, row r of the block), and a block keeps the masks of its open sides
+// (left, right, back, front) and of its elevators. A BFS level moves a whole block at once: the frontier bits AND
+// the open side they leave by (walls are symmetric: a side is open when both rooms are walkable, so the masks of
+// the frontier block are enough), shifted by one column (1 bit) or one row (8 bits), the bits leaving a block
+// landing on the opposite edge of the neighbour block, and the elevator bits landing on the same bits of the block
+// one layer away.
+// Only the blocks of the frontier are read, each one pushes its rooms into the blocks around it, a frontier
+// crossing a block moves up to 64 rooms per word operation (square blocks keep several rooms of a wavefront
+// together whatever its direction). Corridor mazes leave one or two rooms of the wavefront per block, the cost is
+// then a few word operations per block and level. The new rooms of a wide level are kept (and visited) on the pool
+// threads, every block writing only itself.
+
+const std::uint64_t BLOCK_COLUMN_0 = 0x0101010101010101ull;
+const std::uint64_t BLOCK_COLUMN_7 = BLOCK_COLUMN_0 << 7;
+const std::uint64_t BLOCK_ROW_0 = 0xFFull;
+const std::uint64_t BLOCK_ROW_7 = BLOCK_ROW_0 << 56;
+
+typedef struct block_masks {
+    std::uint64_t left;         // Open sides
+    std::uint64_t right;
+    std::uint64_t back;
+    std::uint64_t front;
+    std::uint64_t up;           // Elevators leading to a walkable room
+    std::uint64_t down;
+}block_masks;
+
+typedef struct bit_search {
+    int width;
+    int height;
+    int block_columns;
+    int block_rows;
+    std::size_t layer_blocks;
+    std::size_t blocks;
+    std::vector<block_masks> masks;
+    std::vector<std::uint64_t> visited;     // Bitsets of the same blocks
+    std::vector<std::uint64_t> frontier;
+    std::vector<std::uint64_t> next;
+    std::vector<std::size_t> active;        // Blocks holding the frontier
+    std::vector<std::size_t> touched;       // Blocks the frontier was pushed into (each block once)
+}bit_search;
+
+
+inline std::size_t block_of(const bit_search &search, int layer, int column, int row) {
+    return ((std::size_t)layer * search.block_rows + (row >> 3)) * search.block_columns + (column >> 3);
+}
+
+inline std::uint64_t block_bit(int column, int row) {
+    return (std::uint64_t)1 << ((row & 7) * 8 + (column & 7));
+}
+
+
+// Bits of a row of cell bytes (count <= 64 rooms) whose (byte & select) == value
+inline std::uint64_t select_bits(const std::uint8_t *cells, int count, std::uint8_t select, std::uint8_t value) {
+    std::uint64_t bits = 0;
+    int k = 0;
+#ifdef MAZE_SSE2
+    const __m128i mask = _mm_set1_epi8((char)select), wanted = _mm_set1_epi8((char)value);
+    for (; k + 16 <= count; k += 16) {
+        __m128i bytes = _mm_and_si128(_mm_loadu_si128((const __m128i*)(cells + k)), mask);
+        bits |= (std::uint64_t)(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, wanted)) & 0xFFFF) << k;
+    }
+#endif
+    for (; k < count; ++k)
+        bits |= (std::uint64_t)((cells[k] & select) == value) << k;
+    return bits;
+}
+
+
+// Building the masks of the blocks of block rows [begin, end) (block row b is block row b % block_rows of layer
+// b / block_rows) from the cell bytes, walls already derived. Every grid row gives the masks of 64 columns at once,
+// byte k of them going to row i & 7 of the k-th block. up and down hold the elevators only, walls the wall rooms
+inline void build_block_rows(const maze_grid &grid, bit_search &search, std::vector<std::uint64_t> &walls, int begin, int end) {
+    std::vector<std::uint8_t> buffer(grid.width);
+    for (int b = begin; b < end; ++b) {
+        int layer = b / search.block_rows;
+        int first_row = (b % search.block_rows) * 8;
+        for (int i = first_row; i < std::min(first_row + 8, grid.height); ++i) {
+            const std::uint8_t *row;
+            if (grid.tile_shift == LAYOUT_ROW_MAJOR && grid.cells.data())
+                row = grid.cells.data() + ((std::size_t)layer * grid.height + i) * grid.width;
+            else {
+                for (int j = 0; j < grid.width; ++j)
+                    buffer[j] = grid.cells[grid_index(grid, layer, j, i)];
+                row = buffer.data();
+            }
+
+            for (int first = 0; first < grid.width; first += 64) {
+                int count = std::min(64, grid.width - first);
+                std::uint64_t row_masks[7];
+                row_masks[0] = select_bits(row + first, count, WALL_LEFT << 4, 0);
+                row_masks[1] = select_bits(row + first, count, WALL_RIGHT << 4, 0);
+                row_masks[2] = select_bits(row + first, count, WALL_BACK << 4, 0);
+                row_masks[3] = select_bits(row + first, count, WALL_FRONT << 4, 0);
+                row_masks[4] = select_bits(row + first, count, 0x0F, 2);
+                row_masks[5] = select_bits(row + first, count, 0x0F, 3);
+                row_masks[6] = select_bits(row + first, count, 0x0F, 1);
+
+                int shift = (i & 7) * 8;
+                for (int k = 0; k * 8 < count; ++k) {
+                    std::size_t block = block_of(search, layer, first + k * 8, i);
+                    block_masks &masks = search.masks[block];
+                    masks.left |= (row_masks[0] >> (k * 8) & 0xFF) << shift;
+                    masks.right |= (row_masks[1] >> (k * 8) & 0xFF) << shift;
+                    masks.back |= (row_masks[2] >> (k * 8) & 0xFF) << shift;
+                    masks.front |= (row_masks[3] >> (k * 8) & 0xFF) << shift;
+                    masks.up |= (row_masks[4] >> (k * 8) & 0xFF) << shift;
+                    masks.down |= (row_masks[5] >> (k * 8) & 0xFF) << shift;
+                    walls[block] |= (row_masks[6] >> (k * 8) & 0xFF) << shift;
+                }
+            }
+        }
+    }
+}
+
+
+// Allocating the search state of a maze and building its block masks (again after the maze changes)
+inline void prepare_bit_search(bit_search &search, const maze_model &maze, ThreadPool *pool = nullptr) {
+    const maze_grid &grid = maze.grid;
+    search.width = grid.width;
+    search.height = grid.height;
+    search.block_columns = (grid.width + 7) / 8;
+    search.block_rows = (grid.height + 7) / 8;
+    search.layer_blocks = (std::size_t)search.block_columns * search.block_rows;
+    search.blocks = search.layer_blocks * grid.layers;
+    search.masks.assign(search.blocks, block_masks());
+    search.visited.assign(search.blocks, 0);
+    search.frontier.assign(search.blocks, 0);
+    search.next.assign(search.blocks, 0);
+
+    // Paged grids are read through a cache that is not thread-safe
+    std::vector<std::uint64_t> walls(search.blocks, 0);
+    int block_rows = search.block_rows * grid.layers;
+    std::function<void(int, int)> build = [&](int begin, int end) { build_block_rows(grid, search, walls, begin, end); };
+    if (pool && !grid.cells.paged())
+        pool->parallel_for(block_rows, 8, build);
+    else
+        build(0, block_rows);
+
+    // An elevator leads somewhere only when the room above (below) is not a wall
+    for (std::size_t b = 0; b < search.blocks; ++b) {
+        block_masks &block = search.masks[b];
+        block.up = b + search.layer_blocks < search.blocks ? block.up & ~walls[b + search.layer_blocks] : 0;
+        block.down = b >= search.layer_blocks ? block.down & ~walls[b - search.layer_blocks] : 0;
+    }
+}
+
+
+// Building the masks of one block again from the cells (up and down only lead to walkable rooms)
+inline void refresh_block(bit_search &search, const maze_grid &grid, std::size_t b) {
+    int layer = (int)(b / search.layer_blocks);
+    std::size_t in_layer = b - (std::size_t)layer * search.layer_blocks;
+    int first_column = (int)(in_layer % search.block_columns) * 8, first_row = (int)(in_layer / search.block_columns) * 8;
+    std::uint64_t sides[4] = {0, 0, 0, 0}, up = 0, down = 0;
+    for (int row = first_row; row < std::min(first_row + 8, grid.height); ++row) {
+        for (int column = first_column; column < std::min(first_column + 8, grid.width); ++column) {
+            std::uint8_t cell = grid.cells[grid_index(grid, layer, column, row)];
+            std::uint64_t bit = block_bit(column, row);
+            for (int side = 0; side < 4; ++side)
+                sides[side] |= (cell >> 4 & 1 << side) ? 0 : bit;
+            int type = cell_type_of(cell);
+            if (type == 2 && layer + 1 < grid.layers && cell_type(grid, layer + 1, column, row) != 1)
+                up |= bit;
+            if (type == 3 && layer > 0 && cell_type(grid, layer - 1, column, row) != 1)
+                down |= bit;
+        }
+    }
+    block_masks &masks = search.masks[b];
+    masks.left = sides[0];
+    masks.right = sides[1];
+    masks.back = sides[2];
+    masks.front = sides[3];
+    masks.up = up;
+    masks.down = down;
+}
+
+
+// Bringing the block masks up to date after a room was edited (edit_room): the blocks of the room and of its
+// neighbours, on its layer and the layers it can reach by elevator
+inline void update_block_masks(bit_search &search, const maze_model &maze, int layer, int column, int row) {
+    const maze_grid &grid = maze.grid;
+    const int columns[5] = {0, -1, 1, 0, 0};
+    const int rows[5] = {0, 0, 0, -1, 1};
+    std::size_t blocks[5];
+    int count = 0;
+    for (int k = 0; k < 5; ++k) {
+        int c = column + columns[k], r = row + rows[k];
+        if (!inside_grid(grid, layer, c, r))
+            continue;
+        std::size_t b = block_of(search, 0, c, r);
+        if (std::find(blocks, blocks + count, b) == blocks + count)
+            blocks[count++] = b;
+    }
+    for (int l = std::max(layer - 1, 0); l <= std::min(layer + 1, grid.layers - 1); ++l)
+        for (int k = 0; k < count; ++k)
+            refresh_block(search, grid, l * search.layer_blocks + blocks[k]);
+}
+
+
+// Pushing the frontier of a block into the blocks it reaches at the next level (next, OR-ed), through the open
+// sides and the elevators of the block. A block is added to touched the first time it receives rooms
+inline void push_block(bit_search &search, std::size_t b) {
+    const block_masks &block = search.masks[b];
+    std::uint64_t rooms = search.frontier[b];
+    std::uint64_t left = rooms & block.left, right = rooms & block.right, back = rooms & block.back, front = rooms & block.front;
+    std::uint64_t pushed[7] = {
+        ((left & ~BLOCK_COLUMN_0) >> 1) | ((right & ~BLOCK_COLUMN_7) << 1) | ((back & ~BLOCK_ROW_0) >> 8) | ((front & ~BLOCK_ROW_7) << 8),
+        (left & BLOCK_COLUMN_0) << 7, (right & BLOCK_COLUMN_7) >> 7, (back & BLOCK_ROW_0) << 56, (front & BLOCK_ROW_7) >> 56,
+        rooms & block.up, rooms & block.down};
+    // The sides are closed at the layer borders, the moves leaving a block never go past them
+    std::size_t targets[7] = {b, b - 1, b + 1, b - search.block_columns, b + search.block_columns, b + search.layer_blocks, b - search.layer_blocks};
+    for (int n = 0; n < 7; ++n) {
+        if (!pushed[n])
+            continue;
+        std::uint64_t &next = search.next[targets[n]];
+        if (!next)
+            search.touched.push_back(targets[n]);
+        next |= pushed[n];
+    }
+}
+
+
+// Writing the distance of the rooms of a block into distances (indexed by room_id())
+inline void block_distances(const bit_search &search, std::size_t b, std::uint64_t rooms, int distance, int *distances) {
+    std::size_t layer = b / search.layer_blocks, block = b - layer * search.layer_blocks;
+    int *first = distances + ((layer * search.height + block / search.block_columns * 8) * search.width + block % search.block_columns * 8);
+    while (rooms) {
+        int k = __builtin_ctzll(rooms);
+        first[(std::size_t)(k >> 3) * search.width + (k & 7)] = distance;
+        rooms &= rooms - 1;
+    }
+}
+
+
+// Breadth-first search from a room over every layer. visit(block, rooms, distance) is called with the rooms of a
+// block first reached at a distance (start room included, on the pool threads for different blocks at once), the
+// search ends after the level when it returns false. Returns the number of rooms reached (bit_reachable() tells which)
+template <typename Visit>
+inline long long bit_bfs_visit(bit_search &search, const maze_model &maze, const maze_cell &from, Visit visit, ThreadPool *pool = nullptr) {
+    std::fill(search.visited.begin(), search.visited.end(), 0);
+    if (!walkable(maze.grid, from))
+        return 0;
+
+    std::size_t start = block_of(search, from.layer, from.column, from.row);
+    search.visited[start] = block_bit(from.column, from.row);
+    search.frontier[start] = search.visited[start];
+    search.active.assign(1, start);
+    std::atomic<bool> going(visit(start, search.frontier[start], 0));
+    long long reached = 1;
+
+    int distance = 0;
+    // New rooms of the touched blocks [begin, end), they become their frontier
+    std::function<void(int, int)> keep = [&](int begin, int end) {
+        for (int k = begin; k < end; ++k) {
+            std::size_t b = search.touched[k];
+            std::uint64_t rooms = search.next[b] & ~search.visited[b];
+            search.next[b] = 0;
+            search.frontier[b] = rooms;
+            search.visited[b] |= rooms;
+            if (rooms && !visit(b, rooms, distance))
+                going = false;
+        }
+    };
+    const int parallel_blocks = 4096;
+    while (!search.active.empty() && going) {
+        ++distance;
+        search.touched.clear();
+        for (std::size_t k = 0; k < search.active.size(); ++k)
+            push_block(search, search.active[k]);
+        for (std::size_t k = 0; k < search.active.size(); ++k)
+            search.frontier[search.active[k]] = 0;
+
+        int count = (int)search.touched.size();
+        if (pool && count >= parallel_blocks)
+            pool->parallel_for(count, 1024, keep);
+        else
+            keep(0, count);
+
+        // The new frontier (frontier stays zero outside of it, next is zero again)
+        search.active.clear();
+        for (int k = 0; k < count; ++k) {
+            std::size_t b = search.touched[k];
+            if (search.frontier[b]) {
+                search.active.push_back(b);
+                reached += __builtin_popcountll(search.frontier[b]);
+            }
+        }
+    }
+
+    // Frontier left by a search ended early
+    for (std::size_t k = 0; k < search.active.size(); ++k)
+        search.frontier[search.active[k]] = 0;
+    search.active.clear();
+    return reached;
+}
+
+
+// Breadth-first search from a room over every layer: fills distances (optional, indexed by room_id(), -1 for
+// unreachable rooms) and returns the number of rooms reached
+inline long long bit_bfs(bit_search &search, const maze_model &maze, const maze_cell &from, std::vector<int> *distances, ThreadPool *pool = nullptr) {
+    const maze_grid &grid = maze.grid;
+    if (distances)
+        distances->assign((std::size_t)grid.width * grid.height * grid.layers, -1);
+    int *written = distances ? distances->data() : nullptr;
+    return bit_bfs_visit(search, maze, from, [&](std::size_t b, std::uint64_t rooms, int distance) {
+        if (written)
+            block_distances(search, b, rooms, distance, written);
+        return true;
+    }, pool);
+}
+
+
+// Whether the last bit_bfs() reached a room
+inline bool bit_reachable(const bit_search &search, const maze_cell &cell) {
+    return (search.visited[block_of(search, cell.layer, cell.column, cell.row)] & block_bit(cell.column, cell.row)) != 0;
+}
+#endif
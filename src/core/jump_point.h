@@ -0,0 +1,311 @@
+#ifndef JUMP_POINT_H
+#define JUMP_POINT_H
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "pathfinding.h"
+
+
+// Jump point search (JPS) for the open areas of a maze: A* over the rooms where a shortest route may have to turn,
+// found by scanning straight lines instead of pushing every room. Moves are 4-connected: a route going left or right
+// only has to turn where a side opens next to a wall (a forced turn), a route going back or front also where a
+// left / right scan finds such a room, so the rooms between two jump points are on one row or column. The rooms
+// with a usable elevator are jump points (the elevator is one more move), and so is the goal row for vertical scans.
+// The walls must follow the wall rooms, as derive_walls() makes them (a side is open when the room beyond is walkable).
+// JPS+ precomputes the scans: for every room and side, the distance to the next jump point (> 0) or minus the rooms
+// left before a wall (<= 0), 8 bytes per room. Longer scans than JUMP_LIMIT stop there, which only adds a jump point.
+
+const int JUMP_LIMIT = 32767;
+const int JUMP_ANY = 7;     // Arrival move of a room that is not reached by a scan (the start room): every side
+
+typedef struct jump_table {
+    int width;
+    int height;
+    int layers;
+    std::vector<std::int16_t> distances;    // Room id * 4 + side (MOVE_LEFT to MOVE_FRONT)
+}jump_table;
+
+// Heap entry: f = g + h, the jump point with the move that reached it (id << 3 | move) and the length of that scan
+typedef struct jump_entry {
+    std::uint32_t f;
+    std::uint32_t h;
+    std::uint64_t room;
+    std::uint32_t length;
+}jump_entry;
+
+// Reusable search state, sized for one maze
+typedef struct jump_search {
+    std::size_t rooms;
+    std::vector<std::uint64_t> visited;
+    std::unique_ptr<std::uint32_t[]> jumps;     // Scan that reached each jump point, length << 3 | move (not initialized)
+    std::vector<jump_entry> open;
+}jump_search;
+
+
+// Side of a room open for a move (the wall bits follow the move order)
+inline bool side_open(const maze_grid &grid, std::uint64_t id, int move) {
+    return !((room_byte(grid, id) >> 4) & (1 << move));
+}
+
+inline std::int64_t move_step(const maze_grid &grid, int move) {
+    const std::int64_t steps[4] = {-1, 1, -(std::int64_t)grid.width, (std::int64_t)grid.width};
+    return steps[move];
+}
+
+// Room an elevator leads to (as room_neighbours() takes it), ~0 when the room has no usable elevator
+inline std::uint64_t elevator_target(const maze_grid &grid, std::uint64_t id) {
+    std::uint64_t layer_rooms = (std::uint64_t)grid.width * grid.height;
+    int type = cell_type_of(room_byte(grid, id));
+    if (type == 2 && id + layer_rooms < layer_rooms * grid.layers && cell_type_of(room_byte(grid, id + layer_rooms)) != 1)
+        return id + layer_rooms;
+    if (type == 3 && id >= layer_rooms && cell_type_of(room_byte(grid, id - layer_rooms)) != 1)
+        return id - layer_rooms;
+    return ~(std::uint64_t)0;
+}
+
+// A side opening on a room entered by a move, closed on the room before (a route may have to turn there)
+inline bool forced_turn(const maze_grid &grid, std::uint64_t id, int move, int side) {
+    return side_open(grid, id, side) && !side_open(grid, id - move_step(grid, move), side);
+}
+
+// Room where a scan entering by a move has to stop: an elevator or a forced turn to either side
+// (back / front scans also stop where a left / right scan finds such a room)
+inline bool turning_room(const maze_grid &grid, std::uint64_t id, int move) {
+    int side = move < MOVE_BACK ? MOVE_BACK : MOVE_LEFT;
+    return elevator_target(grid, id) != ~(std::uint64_t)0 || forced_turn(grid, id, move, side) || forced_turn(grid, id, move, side + 1);
+}
+
+
+// Scanning from a room along a side: distance to the next jump point, or minus the rooms left before a wall
+inline int scan_jump(const maze_grid &grid, std::uint64_t id, int move) {
+    std::int64_t step = move_step(grid, move);
+    int k = 0;
+    while (side_open(grid, id, move)) {
+        if (k == JUMP_LIMIT)
+            return k;
+        id += step;
+        ++k;
+        if (turning_room(grid, id, move) || (move >= MOVE_BACK && (scan_jump(grid, id, MOVE_LEFT) > 0 || scan_jump(grid, id, MOVE_RIGHT) > 0)))
+            return k;
+    }
+    return -k;
+}
+
+// Scan distance from the table (JPS+) or scanned now
+inline int jump_distance(const maze_grid &grid, const jump_table *table, std::uint64_t id, int move) {
+    return table ? table->distances[id * 4 + move] : scan_jump(grid, id, move);
+}
+
+
+// Table distance of a room along a side, from the table distance of the room after (the left / right distances
+// must be up to date before the back / front ones)
+inline std::int16_t table_jump(const maze_grid &grid, const std::int16_t *distances, std::uint64_t id, int move) {
+    if (!side_open(grid, id, move))
+        return 0;
+    std::uint64_t next = id + move_step(grid, move);
+    if (turning_room(grid, next, move) || (move >= MOVE_BACK && (distances[next * 4 + MOVE_LEFT] > 0 || distances[next * 4 + MOVE_RIGHT] > 0)))
+        return 1;
+    int after = distances[next * 4 + move];
+    return (std::int16_t)(after > 0 ? std::min(after + 1, JUMP_LIMIT) : (after - 1 < -JUMP_LIMIT ? JUMP_LIMIT : after - 1));
+}
+
+// JPS+ table of a maze: the left / right distances row by row, then the back / front ones in stripes of columns,
+// on the pool threads when one is given
+inline void build_jump_table(jump_table &table, const maze_model &maze, ThreadPool *pool = nullptr) {
+    const maze_grid &grid = maze.grid;
+    table.width = grid.width;
+    table.height = grid.height;
+    table.layers = grid.layers;
+    table.distances.assign((std::size_t)grid.width * grid.height * grid.layers * 4, 0);
+    std::int16_t *distances = table.distances.data();
+
+    std::function<void(int, int)> rows = [&](int begin, int end) {
+        for (int r = begin; r < end; ++r) {
+            std::uint64_t first = (std::uint64_t)r * grid.width;
+            for (int c = grid.width - 1; c >= 0; --c)
+                distances[(first + c) * 4 + MOVE_RIGHT] = table_jump(grid, distances, first + c, MOVE_RIGHT);
+            for (int c = 0; c < grid.width; ++c)
+                distances[(first + c) * 4 + MOVE_LEFT] = table_jump(grid, distances, first + c, MOVE_LEFT);
+        }
+    };
+
+    const int stripe = 256;
+    int stripes = (grid.width + stripe - 1) / stripe;
+    std::function<void(int, int)> columns = [&](int begin, int end) {
+        for (int s = begin; s < end; ++s) {
+            int layer = s / stripes, first_column = s % stripes * stripe, last_column = std::min(first_column + stripe, grid.width);
+            std::uint64_t layer_first = (std::uint64_t)layer * grid.width * grid.height;
+            for (int r = grid.height - 1; r >= 0; --r)
+                for (int c = first_column; c < last_column; ++c)
+                    distances[(layer_first + (std::uint64_t)r * grid.width + c) * 4 + MOVE_FRONT] = table_jump(grid, distances, layer_first + (std::uint64_t)r * grid.width + c, MOVE_FRONT);
+            for (int r = 0; r < grid.height; ++r)
+                for (int c = first_column; c < last_column; ++c)
+                    distances[(layer_first + (std::uint64_t)r * grid.width + c) * 4 + MOVE_BACK] = table_jump(grid, distances, layer_first + (std::uint64_t)r * grid.width + c, MOVE_BACK);
+        }
+    };
+
+    // Paged grids are read through a cache that is not thread-safe
+    if (pool && !grid.cells.paged()) {
+        pool->parallel_for(grid.layers * grid.height, 64, rows);
+        pool->parallel_for(grid.layers * stripes, 1, columns);
+    }
+    else {
+        rows(0, grid.layers * grid.height);
+        columns(0, grid.layers * stripes);
+    }
+}
+
+
+// Bringing the JPS+ table up to date after a room was edited (edit_room). The jump points can only change within
+// two rooms of it (and on the layers its elevator reaches), so the scans are computed again from there, away from
+// the window, until a distance comes out unchanged: left / right scans on the rows of the room and its neighbours,
+// then back / front scans on the columns around the room and on those whose left / right scans changed finding a jump point
+inline void update_jump_table(jump_table &table, const maze_model &maze, int layer, int column, int row) {
+    const maze_grid &grid = maze.grid;
+    const int reach = 2;
+    std::int16_t *distances = table.distances.data();
+    for (int l = std::max(layer - 1, 0); l <= std::min(layer + 1, grid.layers - 1); ++l) {
+        std::uint64_t layer_first = (std::uint64_t)l * grid.width * grid.height;
+        std::vector<int> columns;
+        for (int c = std::max(column - reach, 0); c <= std::min(column + reach, grid.width - 1); ++c)
+            columns.push_back(c);
+
+        for (int r = std::max(row - 1, 0); r <= std::min(row + 1, grid.height - 1); ++r) {
+            std::uint64_t first = layer_first + (std::uint64_t)r * grid.width;
+            for (int direction = 0; direction < 2; ++direction) {
+                int move = direction ? MOVE_LEFT : MOVE_RIGHT, step = direction ? 1 : -1;
+                for (int c = direction ? std::max(column - reach, 0) : std::min(column + reach, grid.width - 1); c >= 0 && c < grid.width; c += step) {
+                    std::int16_t *room = distances + (first + c) * 4;
+                    std::int16_t value = table_jump(grid, distances, first + c, move);
+                    if (value == room[move] && (direction ? c > column + reach : c < column - reach))
+                        break;
+                    bool found = room[MOVE_LEFT] > 0 || room[MOVE_RIGHT] > 0;
+                    room[move] = value;
+                    if (found != (room[MOVE_LEFT] > 0 || room[MOVE_RIGHT] > 0))
+                        columns.push_back(c);
+                }
+            }
+        }
+        std::sort(columns.begin(), columns.end());
+        columns.erase(std::unique(columns.begin(), columns.end()), columns.end());
+
+        for (std::size_t k = 0; k < columns.size(); ++k) {
+            for (int direction = 0; direction < 2; ++direction) {
+                int move = direction ? MOVE_BACK : MOVE_FRONT, step = direction ? 1 : -1;
+                for (int r = direction ? std::max(row - reach, 0) : std::min(row + reach, grid.height - 1); r >= 0 && r < grid.height; r += step) {
+                    std::uint64_t id = layer_first + (std::uint64_t)r * grid.width + columns[k];
+                    std::int16_t value = table_jump(grid, distances, id, move);
+                    if (value == distances[id * 4 + move] && (direction ? r > row + reach : r < row - reach))
+                        break;
+                    distances[id * 4 + move] = value;
+                }
+            }
+        }
+    }
+}
+
+
+inline bool jump_after(const jump_entry &a, const jump_entry &b) {
+    return a.f > b.f || (a.f == b.f && a.h > b.h);
+}
+
+// Walking the scans back from a room to the start of the search (path from start to room, both included)
+inline void trace_jumps(const maze_grid &grid, const jump_search &search, std::uint64_t from, std::uint64_t to, std::vector<maze_cell> &path) {
+    std::uint64_t layer_rooms = (std::uint64_t)grid.width * grid.height;
+    path.clear();
+    for (std::uint64_t id = to; id != from; ) {
+        int move = (int)(search.jumps[id] & 7), length = (int)(search.jumps[id] >> 3);
+        std::int64_t step = move == MOVE_UP ? (std::int64_t)layer_rooms : move == MOVE_DOWN ? -(std::int64_t)layer_rooms : move_step(grid, move);
+        for (int k = 0; k < length; ++k, id -= step)
+            path.push_back(room_cell(grid, id));
+    }
+    path.push_back(room_cell(grid, from));
+    std::reverse(path.begin(), path.end());
+}
+
+
+// Allocating the search state of a maze (done once, queries only clear the bitset)
+inline void prepare_jump_search(jump_search &search, const maze_model &maze) {
+    search.rooms = (std::size_t)maze.grid.width * maze.grid.height * maze.grid.layers;
+    search.visited.assign((search.rooms + 63) / 64, 0);
+    search.jumps.reset(new std::uint32_t[search.rooms]);
+}
+
+
+// Jump point search between two rooms (search prepared by prepare_jump_search): returns the distance (-1 when
+// unreachable), the path (optional) and the number of jump points expanded (optional). Scans use the JPS+ table
+// when one is given
+inline long long jps_search(const maze_model &maze, jump_search &search, const maze_cell &from, const maze_cell &to, std::vector<maze_cell> *path, const jump_table *table = nullptr, long long *expanded = nullptr) {
+    const maze_grid &grid = maze.grid;
+    if (!walkable(grid, from) || !walkable(grid, to))
+        return -1;
+    std::fill(search.visited.begin(), search.visited.end(), 0);
+
+    std::uint64_t start = room_id(grid, from), target = room_id(grid, to);
+    std::vector<jump_entry> &open = search.open;
+    jump_entry first = {path_heuristic(from, to), path_heuristic(from, to), start << 3 | JUMP_ANY, 0};
+    open.assign(1, first);
+
+    while (!open.empty()) {
+        std::pop_heap(open.begin(), open.end(), jump_after);
+        jump_entry entry = open.back();
+        open.pop_back();
+        std::uint64_t id = entry.room >> 3;
+        int move = (int)(entry.room & 7);
+        if (search.visited[id >> 6] >> (id & 63) & 1)
+            continue;
+        search.visited[id >> 6] |= (std::uint64_t)1 << (id & 63);
+        search.jumps[id] = entry.length << 3 | (std::uint32_t)move;
+        if (expanded)
+            ++*expanded;
+        std::uint32_t g = entry.f - entry.h;
+        if (id == target) {
+            if (path)
+                trace_jumps(grid, search, start, target, *path);
+            return (long long)g;
+        }
+
+        // Straight on and both turns (every side from the start room or after an elevator)
+        maze_cell cell = room_cell(grid, id);
+        for (int side = MOVE_LEFT; side <= MOVE_FRONT; ++side) {
+            if ((move < MOVE_UP && side == (move ^ 1)) || !side_open(grid, id, side))
+                continue;
+            int k = jump_distance(grid, table, id, side), reach = k > 0 ? k : -k;
+            // The goal straight ahead, or its row for back / front scans
+            if (cell.layer == to.layer) {
+                bool vertical = side >= MOVE_BACK;
+                int ahead = vertical ? (side == MOVE_FRONT ? to.row - cell.row : cell.row - to.row) : (side == MOVE_RIGHT ? to.column - cell.column : cell.column - to.column);
+                if (ahead > 0 && ahead <= reach && (vertical || to.row == cell.row))
+                    k = ahead;
+            }
+            if (k <= 0)
+                continue;
+            std::uint64_t next = id + move_step(grid, side) * k;
+            if (search.visited[next >> 6] >> (next & 63) & 1)
+                continue;
+            maze_cell reached = cell;
+            reached.column += side == MOVE_LEFT ? -k : side == MOVE_RIGHT ? k : 0;
+            reached.row += side == MOVE_BACK ? -k : side == MOVE_FRONT ? k : 0;
+            std::uint32_t h = path_heuristic(reached, to);
+            jump_entry jump = {g + k + h, h, next << 3 | side, (std::uint32_t)k};
+            open.push_back(jump);
+            std::push_heap(open.begin(), open.end(), jump_after);
+        }
+
+        std::uint64_t landing = elevator_target(grid, id);
+        if (landing != ~(std::uint64_t)0 && !(search.visited[landing >> 6] >> (landing & 63) & 1)) {
+            maze_cell reached = cell;
+            reached.layer += landing > id ? 1 : -1;
+            std::uint32_t h = path_heuristic(reached, to);
+            jump_entry jump = {g + 1 + h, h, landing << 3 | (landing > id ? MOVE_UP : MOVE_DOWN), 1};
+            open.push_back(jump);
+            std::push_heap(open.begin(), open.end(), jump_after);
+        }
+    }
+    return -1;
+}
+#endif
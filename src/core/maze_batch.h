@@ -0,0 +1,143 @@
+#ifndef MAZE_BATCH_H
+#define MAZE_BATCH_H
+
+#include <cstdint>
+#include <vector>
+
+#include "../dependencies/UTILS/thread_pool.h"
+#include "maze_model.h"
+#include "player.h"
+
+
+// N independent maze sessions stepped in lockstep, for training and evaluating agents.
+// Every session plays the same (read-only) maze; each one keeps its own collected items as a bitset.
+// Session state is stored as structure-of-arrays, inputs and observations are flat arrays.
+
+// Observation layout, per session: column, row, layer, heading (degrees), items collected
+const int OBSERVATION_SIZE = 5;
+
+typedef struct maze_batch {
+    const maze_model *maze;
+    int sessions;
+
+    int words_per_session;              // 64-bit words of each session bitset (one bit per collectable id)
+
+    // Session state (SoA)
+    std::vector<float> position_x;
+    std::vector<float> position_z;
+    std::vector<int> layer;
+    std::vector<int> column;
+    std::vector<int> row;
+    std::vector<int> collectables;
+    std::vector<float> heading;
+    std::vector<std::uint64_t> collected;  // sessions * words_per_session
+
+    ThreadPool *pool;
+}maze_batch;
+
+
+// Placing one session on the start room with nothing collected
+inline void reset_session(maze_batch &batch, int session) {
+    player_state player;
+    reset_player(player, *batch.maze);
+    batch.position_x[session] = player.position.x;
+    batch.position_z[session] = player.position.z;
+    batch.layer[session] = player.layer;
+    batch.column[session] = player.element_position.first;
+    batch.row[session] = player.element_position.second;
+    batch.collectables[session] = 0;
+    batch.heading[session] = -90.0f;
+    for (int w = 0; w < batch.words_per_session; ++w)
+        batch.collected[(std::size_t)session * batch.words_per_session + w] = 0;
+}
+
+
+// Preparing a batch of sessions over a loaded maze. The pool (optional) runs the steps in parallel
+inline void create_batch(maze_batch &batch, const maze_model &maze, int sessions, ThreadPool *pool) {
+    batch.maze = &maze;
+    batch.sessions = sessions;
+    batch.pool = pool;
+
+    batch.words_per_session = (maze.total_collectables + 63) / 64;
+
+    batch.position_x.assign(sessions, 0.0f);
+    batch.position_z.assign(sessions, 0.0f);
+    batch.layer.assign(sessions, 0);
+    batch.column.assign(sessions, 0);
+    batch.row.assign(sessions, 0);
+    batch.collectables.assign(sessions, 0);
+    batch.heading.assign(sessions, 0.0f);
+    batch.collected.assign((std::size_t)sessions * batch.words_per_session, 0);
+    for (int s = 0; s < sessions; ++s)
+        reset_session(batch, s);
+}
+
+
+// Stepping sessions [begin, end), same rules as step() but items are marked in the session bitset
+inline void step_sessions(maze_batch &batch, int begin, int end, const int *keys, const float *yaws, const float *pitches, float dt, int *events) {
+    const maze_model &maze = *batch.maze;
+    for (int s = begin; s < end; ++s) {
+        player_state player;
+        player.position = glm::vec3(batch.position_x[s], 0.0f, batch.position_z[s]);
+        player.layer = batch.layer[s];
+        player.element_position = std::make_pair(batch.column[s], batch.row[s]);
+        player.collectables = batch.collectables[s];
+
+        input_state input = {keys[s], yaws[s], pitches ? pitches[s] : 0.0f};
+        int session_events = move_player(maze, player, input, dt);
+
+        // When the player pick up a collectable item (not yet collected in this session)
+        std::size_t index = grid_index(maze.grid, player.layer, player.element_position.first, player.element_position.second);
+        int id = cell_type_of(maze.grid.cells[index]) == 4 ? collectable_id(maze, index) : -1;
+        std::uint64_t *bits = &batch.collected[(std::size_t)s * batch.words_per_session];
+        if (id >= 0 && !(bits[id >> 6] >> (id & 63) & 1) && at_room_center(player)) {
+            bits[id >> 6] |= (std::uint64_t)1 << (id & 63);
+            player.collectables += 1;
+            session_events |= EVENT_COLLECTED;
+        }
+        else if (id < 0)
+            session_events |= take_elevator(maze, player);
+
+        batch.position_x[s] = player.position.x;
+        batch.position_z[s] = player.position.z;
+        batch.layer[s] = player.layer;
+        batch.column[s] = player.element_position.first;
+        batch.row[s] = player.element_position.second;
+        batch.collectables[s] = player.collectables;
+        batch.heading[s] = yaws[s];
+
+        // A won session starts over right away
+        if (player_won(maze, player)) {
+            session_events |= EVENT_WON;
+            reset_session(batch, s);
+        }
+        if (events)
+            events[s] = session_events;
+    }
+}
+
+
+// Stepping every session by dt seconds. keys, yaws and pitches (optional) hold one value per session,
+// events (optional) receives the step_events of each session
+inline void step_batch(maze_batch &batch, const int *keys, const float *yaws, const float *pitches, float dt, int *events) {
+    const int chunk = 1024;
+    // Paged grids are read through a cache that is not thread-safe
+    if (batch.pool && !batch.maze->grid.cells.paged())
+        batch.pool->parallel_for(batch.sessions, chunk, [&](int begin, int end) { step_sessions(batch, begin, end, keys, yaws, pitches, dt, events); });
+    else
+        step_sessions(batch, 0, batch.sessions, keys, yaws, pitches, dt, events);
+}
+
+
+// Writing the observations of every session (sessions * OBSERVATION_SIZE floats)
+inline void observe_batch(const maze_batch &batch, float *observations) {
+    for (int s = 0; s < batch.sessions; ++s) {
+        float *o = observations + (std::size_t)s * OBSERVATION_SIZE;
+        o[0] = (float)batch.column[s];
+        o[1] = (float)batch.row[s];
+        o[2] = (float)batch.layer[s];
+        o[3] = batch.heading[s];
+        o[4] = (float)batch.collectables[s];
+    }
+}
+#endif
@@ -0,0 +1,186 @@
+#ifndef MAZE_BINARY_H
+#define MAZE_BINARY_H
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+
+#include "../dependencies/UTILS/mapped_file.h"
+#include "maze_model.h"
+
+
+// Binary maze format, memory-mapped and used in place (no parsing):
+//   header (128 bytes) | cell plane (layers * height * width bytes, grid byte format) | collectable index
+// The cell plane holds the room types, plus the wall masks when BINARY_WALLS is set (otherwise they are
+// derived at load time). The collectable index (BINARY_COLLECTABLES) lists the grid index of every item;
+// an index that does not match the cell plane is dropped and the items are found in the plane instead.
+
+const char MAZE_BINARY_MAGIC[8] = {'M', 'A', 'Z', 'E', 'B', 'I', 'N', '\0'};
+const std::uint32_t MAZE_BINARY_VERSION = 1;
+const std::uint32_t MAZE_BINARY_BYTE_ORDER = 0x01020304;
+const std::uint64_t MAZE_BINARY_HEADER_SIZE = 128;
+enum maze_binary_flags { BINARY_WALLS = 1, BINARY_COLLECTABLES = 2 };
+
+typedef struct maze_binary_header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order;           // MAZE_BINARY_BYTE_ORDER as written by the producer
+    std::uint32_t flags;
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t layers;
+    std::int32_t start_column;
+    std::int32_t start_row;
+    std::uint32_t total_collectables;
+    std::uint32_t reserved;
+    std::uint64_t cells_offset;
+    std::uint64_t cells_size;
+    std::uint64_t collectables_offset;  // total_collectables uint64 grid indices
+}maze_binary_header;
+static_assert(sizeof(maze_binary_header) <= MAZE_BINARY_HEADER_SIZE, "maze_binary_header must fit in the header block");
+
+
+// Checking if a file starts with the binary maze magic
+inline bool is_maze_binary(const char *file_name) {
+    std::ifstream file(file_name, std::ios::binary);
+    char magic[8];
+    return file.read(magic, sizeof(magic)) && std::memcmp(magic, MAZE_BINARY_MAGIC, sizeof(magic)) == 0;
+}
+
+
+// Header of a binary maze, the cell plane right after it and the collectable index after the plane (8-byte aligned)
+inline maze_binary_header binary_header(int width, int height, int layers, std::pair<int, int> start, std::uint32_t total_collectables, std::uint32_t flags) {
+    maze_binary_header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MAZE_BINARY_MAGIC, sizeof(header.magic));
+    header.version = MAZE_BINARY_VERSION;
+    header.byte_order = MAZE_BINARY_BYTE_ORDER;
+    header.flags = flags;
+    header.width = width;
+    header.height = height;
+    header.layers = layers;
+    header.start_column = start.first;
+    header.start_row = start.second;
+    header.total_collectables = total_collectables;
+    header.cells_offset = MAZE_BINARY_HEADER_SIZE;
+    header.cells_size = (std::uint64_t)width * height * layers;
+    header.collectables_offset = (header.cells_offset + header.cells_size + 7) / 8 * 8;
+    return header;
+}
+
+
+// Checking the header of a file of size bytes before anything is read through it: the sizes (they must fit the
+// grid functions) and the offsets stay inside the file, the start room is inside layer 0
+inline bool valid_binary_header(const maze_binary_header &header, std::uint64_t size) {
+    const std::uint32_t max_side = 0x7FFFFFFF;
+    if (header.width == 0 || header.height == 0 || header.layers == 0 || header.width > max_side || header.height > max_side || header.layers > max_side)
+        return false;
+    if (header.cells_size != (std::uint64_t)header.width * header.height * header.layers || header.cells_size / header.layers / header.height != header.width)
+        return false;
+    if (header.cells_offset > size || header.cells_size > size - header.cells_offset)
+        return false;
+    if (header.start_column < 0 || (std::uint32_t)header.start_column >= header.width || header.start_row < 0 || (std::uint32_t)header.start_row >= header.height)
+        return false;
+    if (!(header.flags & BINARY_COLLECTABLES))
+        return true;
+    return header.total_collectables <= max_side && header.collectables_offset % 8 == 0 && header.collectables_offset <= size &&
+           (std::uint64_t)header.total_collectables * sizeof(std::uint64_t) <= size - header.collectables_offset;
+}
+
+// Checking a collectable index against the cell plane: grid indices inside it, in increasing order (no
+// duplicates), each one of a collectable room (type 4)
+inline bool valid_collectable_index(const std::uint64_t *cells, std::uint64_t count, const std::uint8_t *plane, std::uint64_t cells_size) {
+    for (std::uint64_t k = 0; k < count; ++k)
+        if (cells[k] >= cells_size || (k > 0 && cells[k] <= cells[k - 1]) || cell_type_of(plane[cells[k]]) != 4)
+            return false;
+    return true;
+}
+
+
+// Writing a maze in the binary format (flags choose the optional wall masks and collectable index).
+// The cell plane is always row-major, tiled mazes are written from a row-major copy (with the items put back)
+inline bool save_maze_binary(const maze_model &maze, const char *file_name, std::uint32_t flags = BINARY_WALLS | BINARY_COLLECTABLES) {
+    if (maze.grid.tile_shift != LAYOUT_ROW_MAJOR) {
+        maze_model row_major = maze;
+        set_maze_layout(row_major, LAYOUT_ROW_MAJOR);
+        return save_maze_binary(row_major, file_name, flags);
+    }
+    std::ofstream file(file_name, std::ios::binary | std::ios::trunc);
+    if (!file)
+        return false;
+
+    maze_binary_header header = binary_header(maze.grid.width, maze.grid.height, maze.grid.layers, maze.initial_element_position, maze.total_collectables, flags);
+
+    char padding[MAZE_BINARY_HEADER_SIZE] = {0};
+    file.write((const char*)&header, sizeof(header));
+    file.write(padding, MAZE_BINARY_HEADER_SIZE - sizeof(header));
+
+    // Cell plane, written in blocks (types only when the walls are left out)
+    const std::size_t block = 1 << 20;
+    std::vector<std::uint8_t> buffer;
+    for (std::size_t begin = 0; begin < maze.grid.cells.size(); begin += block) {
+        std::size_t end = std::min(begin + block, maze.grid.cells.size());
+        if (maze.grid.cells.paged()) {
+            buffer.resize(end - begin);
+            for (std::size_t i = begin; i < end; ++i)
+                buffer[i - begin] = maze.grid.cells[i];
+        }
+        else
+            buffer.assign(maze.grid.cells.data() + begin, maze.grid.cells.data() + end);
+        if (!(flags & BINARY_WALLS))
+            for (std::size_t i = 0; i < buffer.size(); ++i)
+                buffer[i] &= 0x0F;
+        file.write((const char*)buffer.data(), buffer.size());
+    }
+
+    if (flags & BINARY_COLLECTABLES) {
+        file.write(padding, header.collectables_offset - header.cells_offset - header.cells_size);
+        file.write((const char*)maze.collectable_cells.data(), maze.collectable_cells.size() * sizeof(std::uint64_t));
+    }
+    return (bool)file;
+}
+
+
+// Loading a binary maze: the file is mapped (copy-on-write) and the grid uses the cell plane in place.
+// The pool (optional) derives the walls when the file has none. When memory_budget is set and the cell plane
+// is larger, the grid is paged instead: chunks of the plane are loaded on demand within the budget
+// (the file must hold the walls)
+inline bool load_maze_binary(maze_model &maze, const char *file_name, ThreadPool *pool = nullptr, std::size_t memory_budget = 0) {
+    std::shared_ptr<MappedFile> mapping = std::make_shared<MappedFile>();
+    if (!mapping->open(file_name) || mapping->size() < MAZE_BINARY_HEADER_SIZE)
+        return false;
+
+    maze_binary_header header;
+    std::memcpy(&header, mapping->data(), sizeof(header));
+    if (std::memcmp(header.magic, MAZE_BINARY_MAGIC, sizeof(header.magic)) != 0 || header.version != MAZE_BINARY_VERSION || header.byte_order != MAZE_BINARY_BYTE_ORDER)
+        return false;
+    if (!valid_binary_header(header, mapping->size()))
+        return false;
+    // A damaged collectable index is dropped, the items are found in the cell plane instead
+    const std::uint64_t *collectables = (header.flags & BINARY_COLLECTABLES) ? (const std::uint64_t*)(mapping->data() + header.collectables_offset) : nullptr;
+    if (collectables && !valid_collectable_index(collectables, header.total_collectables, mapping->data() + header.cells_offset, header.cells_size))
+        collectables = nullptr;
+
+    set_grid_size(maze.grid, header.width, header.height, header.layers);
+    if (memory_budget > 0 && header.cells_size > memory_budget && (header.flags & BINARY_WALLS)) {
+        std::shared_ptr<PagedCells> pages = std::make_shared<PagedCells>(mapping, mapping->data() + header.cells_offset, header.width, header.height, header.layers, memory_budget);
+        maze.grid.cells.page(pages, header.cells_size);
+    }
+    else
+        maze.grid.cells.map(mapping, mapping->data() + header.cells_offset, header.cells_size);
+    maze.initial_element_position = std::make_pair((int)header.start_column, (int)header.start_row);
+
+    if (collectables) {
+        maze.collectable_cells.assign(collectables, collectables + header.total_collectables);
+        maze.total_collectables = header.total_collectables;
+        maze.picked.assign((maze.collectable_cells.size() + 63) / 64, 0);
+    }
+    else
+        index_collectables(maze);
+
+    if (!(header.flags & BINARY_WALLS))
+        derive_walls(maze.grid, pool);
+    return true;
+}
+#endif
@@ -0,0 +1,215 @@
+#ifndef MAZE_CONNECTIVITY_H
+#define MAZE_CONNECTIVITY_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "frontier_bfs.h"
+
+
+// Checking a maze before it is played: which collectables the player can get to from the start room, which
+// elevators lead nowhere (an up elevator on the top layer or under a wall, a down elevator on layer 0 or over a
+// wall, the README warns about them), how the walkable rooms split into components and how long the longest
+// shortest route is. Components come from a union-find over the rooms (open sides and elevators joined either way):
+// bands of rows are joined on the pool threads, every band only touching its own rooms, then the band borders and the
+// elevators are joined and the labels made dense in one pass (4 bytes per room). A root is always the smallest room
+// id of its set, so that pass only looks back. Reachability and the diameter use the bitmask BFS (elevators one way).
+
+const std::uint32_t COMPONENT_NONE = 0xFFFFFFFFu;  // Label of the wall rooms
+const int COMPONENT_BAND_ROWS = 64;                // Grid rows joined by one task
+
+typedef struct maze_connectivity {
+    long long walkable_rooms;
+    long long components;                   // Sets of rooms joined by open sides or elevators (either way)
+    long long largest_component;            // Rooms of the largest one
+    long long start_component;              // Rooms of the start room's one
+    long long reachable_rooms;              // Rooms the player can walk to from the start room
+    int diameter;                           // Longest shortest route found by a double sweep from the start room
+    maze_cell diameter_ends[2];             // (a lower bound, exact when the reachable rooms form a tree)
+    std::vector<maze_cell> unreachable_collectables;
+    std::vector<maze_cell> dead_elevators;
+}maze_connectivity;
+
+
+// Root of a room, halving the path on the way (parents are never larger than their room)
+inline std::uint32_t component_root(std::uint32_t *parents, std::uint32_t id) {
+    while (parents[id] != id) {
+        parents[id] = parents[parents[id]];
+        id = parents[id];
+    }
+    return id;
+}
+
+// Joining the sets of two rooms, the larger root goes under the smaller one
+inline void join_components(std::uint32_t *parents, std::uint32_t a, std::uint32_t b) {
+    a = component_root(parents, a);
+    b = component_root(parents, b);
+    if (a < b)
+        parents[b] = a;
+    else if (b < a)
+        parents[a] = b;
+}
+
+
+// Whether an elevator room leads to a walkable room (type 2 up, type 3 down)
+inline bool elevator_leads(const maze_grid &grid, std::uint64_t id, int type) {
+    std::uint64_t layer_rooms = (std::uint64_t)grid.width * grid.height;
+    if (type == 2)
+        return id + layer_rooms < layer_rooms * grid.layers && cell_type_of(room_byte(grid, id + layer_rooms)) != 1;
+    return id >= layer_rooms && cell_type_of(room_byte(grid, id - layer_rooms)) != 1;
+}
+
+
+// Component of every room (room_id() order, dense labels from 0 in order of their smallest room, COMPONENT_NONE
+// for walls); sizes (optional) receives the rooms of each. dead (optional) receives the elevators leading nowhere.
+// Returns the number of components, -1 for mazes of 2^32 - 1 rooms or more (nothing labelled)
+inline long long component_labels(const maze_model &maze, std::vector<std::uint32_t> &labels, std::vector<std::uint32_t> *sizes = nullptr, std::vector<maze_cell> *dead = nullptr, ThreadPool *pool = nullptr) {
+    const maze_grid &grid = maze.grid;
+    std::uint64_t rooms = (std::uint64_t)grid.width * grid.height * grid.layers;
+    if (rooms >= COMPONENT_NONE)
+        return -1;
+    std::uint64_t layer_rooms = (std::uint64_t)grid.width * grid.height;
+    labels.resize(rooms);
+    std::uint32_t *parents = labels.data();
+    int total_rows = grid.height * grid.layers;
+    int bands = (total_rows + COMPONENT_BAND_ROWS - 1) / COMPONENT_BAND_ROWS;
+    std::vector<std::vector<std::uint32_t> > elevators(bands);     // Elevator rooms leading somewhere
+    std::vector<std::vector<std::uint32_t> > dead_rooms(bands);
+
+    // Open sides inside every band of rows, the walls have no set
+    std::function<void(int, int)> join_bands = [&](int begin, int end) {
+        std::vector<std::uint8_t> row(grid.width);
+        for (int band = begin; band < end; ++band) {
+            int first = band * COMPONENT_BAND_ROWS, last = std::min(first + COMPONENT_BAND_ROWS, total_rows);
+            for (int global_row = first; global_row < last; ++global_row) {
+                int layer = global_row / grid.height, r = global_row % grid.height;
+                copy_layer_rows(view_layer(grid, layer), r, r + 1, row.data());
+                std::uint32_t base = (std::uint32_t)((std::uint64_t)global_row * grid.width);
+                for (int c = 0; c < grid.width; ++c) {
+                    std::uint32_t id = base + c;
+                    int type = cell_type_of(row[c]), walls = row[c] >> 4;
+                    if (type == 1) {
+                        parents[id] = COMPONENT_NONE;
+                        continue;
+                    }
+                    parents[id] = id;
+                    if (!(walls & WALL_LEFT))
+                        join_components(parents, id, id - 1);
+                    if (!(walls & WALL_BACK) && global_row > first)
+                        join_components(parents, id, id - grid.width);
+                    if (type == 2 || type == 3)
+                        (elevator_leads(grid, id, type) ? elevators : dead_rooms)[band].push_back(id);
+                }
+            }
+        }
+    };
+    // Paged grids are read through a cache that is not thread-safe
+    if (pool && !grid.cells.paged())
+        pool->parallel_for(bands, 1, join_bands);
+    else
+        join_bands(0, bands);
+
+    // Band borders, then the elevators (both rooms of an elevator are walkable)
+    for (int band = 1; band < bands; ++band) {
+        int global_row = band * COMPONENT_BAND_ROWS;
+        if (global_row % grid.height == 0)
+            continue;
+        std::uint32_t base = (std::uint32_t)((std::uint64_t)global_row * grid.width);
+        for (int c = 0; c < grid.width; ++c)
+            if (parents[base + c] != COMPONENT_NONE && !(room_byte(grid, base + c) >> 4 & WALL_BACK))
+                join_components(parents, base + c, base + c - grid.width);
+    }
+    for (int band = 0; band < bands; ++band) {
+        for (std::size_t k = 0; k < elevators[band].size(); ++k) {
+            std::uint32_t id = elevators[band][k];
+            join_components(parents, id, cell_type_of(room_byte(grid, id)) == 2 ? id + (std::uint32_t)layer_rooms : id - (std::uint32_t)layer_rooms);
+        }
+        if (dead)
+            for (std::size_t k = 0; k < dead_rooms[band].size(); ++k)
+                dead->push_back(room_cell(grid, dead_rooms[band][k]));
+    }
+
+    // Dense labels: a root comes before the other rooms of its set, which then read its label through their parent
+    long long components = 0;
+    if (sizes)
+        sizes->clear();
+    for (std::uint64_t id = 0; id < rooms; ++id) {
+        std::uint32_t parent = parents[id];
+        if (parent == COMPONENT_NONE)
+            continue;
+        parents[id] = parent == id ? (std::uint32_t)components++ : parents[parent];
+        if (sizes && parent == id)
+            sizes->push_back(0);
+        if (sizes)
+            ++(*sizes)[parents[id]];
+    }
+    return components;
+}
+
+
+// Room of a block bit (inverse of block_of() and block_bit())
+inline maze_cell block_cell(const bit_search &search, std::size_t b, int bit) {
+    maze_cell cell;
+    cell.layer = (int)(b / search.layer_blocks);
+    std::size_t block = b - (std::size_t)cell.layer * search.layer_blocks;
+    cell.row = (int)(block / search.block_columns) * 8 + bit / 8;
+    cell.column = (int)(block % search.block_columns) * 8 + bit % 8;
+    return cell;
+}
+
+// BFS from a room that keeps one of the farthest rooms reached: returns its distance, reached (optional) receives
+// the number of rooms reached (bit_reachable() tells which)
+inline int farthest_room(bit_search &search, const maze_model &maze, const maze_cell &from, maze_cell &farthest, long long *reached = nullptr, ThreadPool *pool = nullptr) {
+    std::atomic<int> distance(0);
+    std::atomic<std::uint64_t> room((std::uint64_t)block_of(search, from.layer, from.column, from.row) << 6 | __builtin_ctzll(block_bit(from.column, from.row)));
+    long long count = bit_bfs_visit(search, maze, from, [&](std::size_t b, std::uint64_t rooms, int level) {
+        if (level > distance) {
+            distance = level;
+            room = (std::uint64_t)b << 6 | __builtin_ctzll(rooms);
+        }
+        return true;
+    }, pool);
+    farthest = block_cell(search, (std::size_t)(room >> 6), (int)(room & 63));
+    if (reached)
+        *reached = count;
+    return distance;
+}
+
+
+// Checking the maze (see above), the collectables are the ones of collectable_cells (picked or not)
+inline void analyze_connectivity(const maze_model &maze, maze_connectivity &report, ThreadPool *pool = nullptr) {
+    const maze_grid &grid = maze.grid;
+    maze_cell start = {0, maze.initial_element_position.first, maze.initial_element_position.second};
+
+    std::vector<std::uint32_t> labels, sizes;
+    report.dead_elevators.clear();
+    report.components = component_labels(maze, labels, &sizes, &report.dead_elevators, pool);
+    report.walkable_rooms = 0;
+    report.largest_component = 0;
+    for (std::size_t k = 0; k < sizes.size(); ++k) {
+        report.walkable_rooms += sizes[k];
+        report.largest_component = std::max(report.largest_component, (long long)sizes[k]);
+    }
+    report.start_component = walkable(grid, start) && report.components > 0 ? sizes[labels[room_id(grid, start)]] : 0;
+    std::vector<std::uint32_t>().swap(labels);
+
+    // Rooms reached from the start and the farthest one, then the farthest room from there (the double sweep)
+    bit_search search;
+    prepare_bit_search(search, maze, pool);
+    report.diameter = 0;
+    report.diameter_ends[0] = report.diameter_ends[1] = start;
+    report.unreachable_collectables.clear();
+    farthest_room(search, maze, start, report.diameter_ends[0], &report.reachable_rooms, pool);
+    for (std::size_t k = 0; k < maze.collectable_cells.size(); ++k) {
+        maze_cell item;
+        index_position(grid, maze.collectable_cells[k], item.layer, item.column, item.row);
+        if (!report.reachable_rooms || !bit_reachable(search, item))
+            report.unreachable_collectables.push_back(item);
+    }
+    if (report.reachable_rooms)
+        report.diameter = farthest_room(search, maze, report.diameter_ends[0], report.diameter_ends[1], nullptr, pool);
+}
+#endif
@@ -0,0 +1,378 @@
+#ifndef MAZE_CROWD_H
+#define MAZE_CROWD_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "../dependencies/UTILS/thread_pool.h"
+#include "player.h"
+#include "pathfinding.h"
+
+
+// Autonomous agents walking one shared maze, competing for its collectables: every agent picks an item nobody
+// has claimed yet and walks it room center to room center, steering with the player's inputs (move_player(), so
+// the walls stop agents exactly as they stop the player). The first agent to reach an item claims it; when every
+// item is claimed a new round starts. Agents never change the maze (the player's items stay where they are), they
+// go through each other and only ride an elevator when the way to their item takes it.
+// Agents do not plan routes: every item has a distance field shared by all the agents walking to it (the distance
+// of each room to the item, two bytes per room), an agent steps to the neighbour room one closer. Fields are built a
+// few per step on the pool threads, kept from round to round within a memory budget (the fields of claimed items
+// are reused first) and rebuilt after the rooms are edited. Agent state is stored as structure-of-arrays and
+// stepped in small chunks that the pool threads grab until none is left; arrivals are claimed in agent order, so
+// a run does not depend on the number of threads.
+
+const int CROWD_CHUNK = 256;                            // Agents stepped by one task
+const int CROWD_FIELDS_PER_STEP = 4;                    // Fields built at most per step (not per thread, runs stay the same)
+const std::uint64_t CROWD_FIELD_BUDGET = 256ull << 20;  // Bytes of distance fields (two bytes per room each)
+const std::uint16_t CROWD_FAR = 0;                      // Field value of the rooms that cannot reach the item
+
+typedef struct maze_crowd {
+    const maze_model *maze;
+    int agents;
+    int fields_per_step;
+
+    // Agent state (SoA)
+    std::vector<float> position_x;
+    std::vector<float> position_z;
+    std::vector<int> layer;
+    std::vector<int> column;
+    std::vector<int> row;
+    std::vector<float> heading;                         // Yaw (degrees) of the last move
+    std::vector<int> target;                            // Collectable id walked to, -1 when wandering
+    std::vector<std::uint64_t> next;                    // Room walked to (first the center of the room it stands in)
+    std::vector<int> collectables;                      // Items claimed
+    std::vector<std::uint64_t> seeds;                   // Random state of the target choices
+    std::vector<std::uint8_t> arrived;                  // Reached the target during the current step
+
+    // Shared state
+    std::vector<std::uint64_t> claimed;                 // One bit per collectable id, cleared every round
+    int claimed_count;
+    long long claims;                                   // Items claimed over all rounds
+    std::vector<std::vector<std::uint16_t> > fields;    // Distance fields, allocated for the first items walked to
+    std::vector<int> field_items;                       // Collectable id of every field, -1 for none
+    std::vector<std::uint8_t> stale;                    // Field built before the last room edit
+    std::vector<int> item_fields;                       // Field of every collectable id, -1 for none
+    std::size_t max_fields;
+    std::vector<int> open_items;                        // Items not claimed with a field, the agents pick among them
+    std::vector<int> building;                          // Fields built during the current step
+    std::vector<std::vector<std::uint64_t> > queues;    // One per field built at once
+
+    ThreadPool *pool;
+}maze_crowd;
+
+
+// Random number of an agent (xorshift64*)
+inline std::uint64_t crowd_random(std::uint64_t &state) {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545F4914F6CDD1Dull;
+}
+
+// Random walkable room, the given room when none was drawn
+inline maze_cell crowd_room(const maze_grid &grid, std::uint64_t &state, const maze_cell &fallback) {
+    std::uint64_t rooms = (std::uint64_t)grid.width * grid.height * grid.layers;
+    for (int attempt = 0; attempt < 64; ++attempt) {
+        maze_cell cell = room_cell(grid, crowd_random(state) % rooms);
+        if (walkable(grid, cell))
+            return cell;
+    }
+    return fallback;
+}
+
+// Room of a collectable
+inline std::uint64_t crowd_item_room(const maze_model &maze, int id) {
+    maze_cell cell;
+    index_position(maze.grid, maze.collectable_cells[id], cell.layer, cell.column, cell.row);
+    return room_id(maze.grid, cell);
+}
+
+
+// Preparing a crowd of agents on random walkable rooms of a loaded maze. The pool (optional) runs the steps
+// and builds the fields in parallel. The fields wait for the first step, a crowd without agents never allocates them
+inline void create_crowd(maze_crowd &crowd, const maze_model &maze, int agents, std::uint64_t seed, ThreadPool *pool) {
+    crowd.maze = &maze;
+    crowd.agents = agents;
+    crowd.fields_per_step = CROWD_FIELDS_PER_STEP;
+    crowd.pool = pool;
+
+    crowd.position_x.assign(agents, 0.0f);
+    crowd.position_z.assign(agents, 0.0f);
+    crowd.layer.assign(agents, 0);
+    crowd.column.assign(agents, 0);
+    crowd.row.assign(agents, 0);
+    crowd.heading.assign(agents, -90.0f);
+    crowd.target.assign(agents, -1);
+    crowd.next.assign(agents, 0);
+    crowd.collectables.assign(agents, 0);
+    crowd.seeds.assign(agents, 0);
+    crowd.arrived.assign(agents, 0);
+
+    maze_cell start = {0, maze.initial_element_position.first, maze.initial_element_position.second};
+    for (int a = 0; a < agents; ++a) {
+        crowd.seeds[a] = ((seed + 1) * 0x9E3779B97F4A7C15ull + (std::uint64_t)a * 0xBF58476D1CE4E5B9ull) | 1;
+        maze_cell cell = crowd_room(maze.grid, crowd.seeds[a], start);
+        crowd.position_x[a] = ROOM_SIZE * (float)cell.column;
+        crowd.position_z[a] = ROOM_SIZE * (float)cell.row;
+        crowd.layer[a] = cell.layer;
+        crowd.column[a] = cell.column;
+        crowd.row[a] = cell.row;
+        crowd.next[a] = room_id(maze.grid, cell);
+    }
+
+    crowd.claimed.assign((maze.total_collectables + 63) / 64, 0);
+    crowd.claimed_count = 0;
+    crowd.claims = 0;
+    std::uint64_t rooms = (std::uint64_t)maze.grid.width * maze.grid.height * maze.grid.layers;
+    crowd.fields.clear();
+    crowd.field_items.clear();
+    crowd.stale.clear();
+    crowd.item_fields.assign(maze.total_collectables, -1);
+    crowd.max_fields = (std::size_t)std::max<std::uint64_t>(CROWD_FIELD_BUDGET / (2 * std::max<std::uint64_t>(rooms, 1)), 1);
+    crowd.open_items.clear();
+    crowd.building.clear();
+    crowd.queues.clear();
+}
+
+// The rooms were edited: every field is rebuilt, the agents keep walking on the old ones until then
+inline void crowd_maze_edited(maze_crowd &crowd) {
+    std::fill(crowd.stale.begin(), crowd.stale.end(), 1);
+}
+
+
+// Checking a move against the maze (it may have been edited since the agent chose it)
+inline bool crowd_move_open(const maze_grid &grid, std::uint64_t from, std::uint64_t to) {
+    std::uint64_t ids[6];
+    std::uint8_t moves[6];
+    int count = room_neighbours(grid, from, ids, moves);
+    for (int n = 0; n < count; ++n)
+        if (ids[n] == to)
+            return true;
+    return false;
+}
+
+
+// Distance field of an item: a BFS from the item room along the moves taken backwards (the walls are symmetric,
+// the elevators are not: a room is reached from the elevator below going up and from the one above going down).
+// A room stores its distance % 65535 + 1, CROWD_FAR when it cannot reach the item: a move leads at most one
+// room closer, so the neighbour one closer is found on the low bits (an elevator can lead 65534 rooms farther)
+inline void build_crowd_field(const maze_grid &grid, std::uint64_t item, std::vector<std::uint16_t> &field, std::vector<std::uint64_t> &queue) {
+    std::uint64_t layer_rooms = (std::uint64_t)grid.width * grid.height, rooms = layer_rooms * grid.layers;
+    field.assign(rooms, CROWD_FAR);
+    queue.clear();
+    field[item] = 1;
+    queue.push_back(item);
+    for (std::size_t head = 0; head < queue.size(); ++head) {
+        std::uint64_t id = queue[head];
+        std::uint8_t byte = room_byte(grid, id);
+        if (cell_type_of(byte) == 1)
+            continue;
+        std::uint64_t from[6];
+        int walls = byte >> 4, count = 0;
+        if (!(walls & WALL_LEFT)) from[count++] = id - 1;
+        if (!(walls & WALL_RIGHT)) from[count++] = id + 1;
+        if (!(walls & WALL_BACK)) from[count++] = id - grid.width;
+        if (!(walls & WALL_FRONT)) from[count++] = id + grid.width;
+        if (id >= layer_rooms && cell_type_of(room_byte(grid, id - layer_rooms)) == 2)
+            from[count++] = id - layer_rooms;
+        if (id + layer_rooms < rooms && cell_type_of(room_byte(grid, id + layer_rooms)) == 3)
+            from[count++] = id + layer_rooms;
+        std::uint16_t distance = field[id] == 65535 ? 1 : (std::uint16_t)(field[id] + 1);
+        for (int n = 0; n < count; ++n) {
+            if (field[from[n]] != CROWD_FAR)
+                continue;
+            field[from[n]] = distance;
+            queue.push_back(from[n]);
+        }
+    }
+}
+
+
+// Next room of an agent standing at the center of a room: the neighbour one closer to its target on the target's
+// field. An agent whose target was claimed (or lost its field) picks another item; without any item to walk to,
+// or when its target cannot be reached from here, it wanders to a random neighbour
+inline std::uint64_t crowd_next_room(maze_crowd &crowd, int a, std::uint64_t room) {
+    const maze_model &maze = *crowd.maze;
+    int &id = crowd.target[a];
+    if (id >= 0 && (crowd.claimed[id >> 6] >> (id & 63) & 1 || crowd.item_fields[id] < 0))
+        id = -1;
+    if (id < 0 && !crowd.open_items.empty())
+        id = crowd.open_items[crowd_random(crowd.seeds[a]) % crowd.open_items.size()];
+
+    std::uint64_t ids[6];
+    std::uint8_t moves[6];
+    int count = room_neighbours(maze.grid, room, ids, moves);
+    if (id >= 0) {
+        if (room == crowd_item_room(maze, id))
+            return room;
+        const std::vector<std::uint16_t> &field = crowd.fields[crowd.item_fields[id]];
+        if (field[room] != CROWD_FAR) {
+            std::uint16_t closer = field[room] == 1 ? 65535 : (std::uint16_t)(field[room] - 1);
+            for (int n = 0; n < count; ++n)
+                if (field[ids[n]] == closer)
+                    return ids[n];
+        }
+        id = -1;
+    }
+    if (count == 0)
+        return room;
+    return ids[crowd_random(crowd.seeds[a]) % count];
+}
+
+
+// Stepping agents [begin, end) by dt seconds: each one walks toward the center of its next room and takes the
+// elevator when that room is up or down, at the center it arrives at its target or chooses the next room
+inline void step_agents(maze_crowd &crowd, int begin, int end, float dt) {
+    const maze_model &maze = *crowd.maze;
+    const maze_grid &grid = maze.grid;
+    const float speed = 1.5f * PLAYER_SPEED;
+    for (int a = begin; a < end; ++a) {
+        maze_cell here = {crowd.layer[a], crowd.column[a], crowd.row[a]};
+        std::uint64_t room = room_id(grid, here);
+        if (crowd.next[a] != room && !crowd_move_open(grid, room, crowd.next[a]))
+            crowd.next[a] = room;
+        maze_cell next = room_cell(grid, crowd.next[a]);
+
+        player_state player;
+        player.position = glm::vec3(crowd.position_x[a], 0.0f, crowd.position_z[a]);
+        player.layer = crowd.layer[a];
+        player.element_position = std::make_pair(crowd.column[a], crowd.row[a]);
+        player.collectables = crowd.collectables[a];
+
+        // Forward toward the room center, the last move shortened so that it stops there
+        float dx = ROOM_SIZE * (float)next.column - player.position.x;
+        float dz = ROOM_SIZE * (float)next.row - player.position.z;
+        float distance = std::sqrt(dx * dx + dz * dz);
+        if (distance > 0.0f) {
+            input_state input = {KEY_FORWARD, std::atan2(dz, dx) * (180.0f / 3.14159265f), 0.0f};
+            move_player(maze, player, input, std::min(dt, distance / speed));
+            crowd.heading[a] = input.yaw;
+        }
+        std::pair<int, int> next_room = std::make_pair(next.column, next.row);
+        if (next.layer != player.layer && player.element_position == next_room)
+            take_elevator(maze, player);
+        if (next.layer == player.layer && player.element_position == next_room && at_room_center(player)) {
+            int id = crowd.target[a];
+            if (id >= 0 && crowd.next[a] == crowd_item_room(maze, id))
+                crowd.arrived[a] = 1;
+            else
+                crowd.next[a] = crowd_next_room(crowd, a, crowd.next[a]);
+        }
+
+        crowd.position_x[a] = player.position.x;
+        crowd.position_z[a] = player.position.z;
+        crowd.layer[a] = player.layer;
+        crowd.column[a] = player.element_position.first;
+        crowd.row[a] = player.element_position.second;
+    }
+}
+
+
+// Building the fields of up to fields_per_step items not claimed yet that have none (or an old one), in id
+// order. A new field takes a free slot of the budget, then the slot of a claimed item
+inline void update_crowd_fields(maze_crowd &crowd, ThreadPool *pool) {
+    const maze_model &maze = *crowd.maze;
+    crowd.building.clear();
+    for (int id = 0; id < maze.total_collectables && (int)crowd.building.size() < crowd.fields_per_step; ++id) {
+        if (crowd.claimed[id >> 6] >> (id & 63) & 1)
+            continue;
+        int f = crowd.item_fields[id];
+        if (f >= 0 && !crowd.stale[f])
+            continue;
+        if (f < 0 && crowd.fields.size() < crowd.max_fields) {
+            f = (int)crowd.fields.size();
+            crowd.fields.emplace_back();
+            crowd.field_items.push_back(-1);
+            crowd.stale.push_back(0);
+        }
+        for (std::size_t k = 0; f < 0 && k < crowd.fields.size(); ++k) {
+            int item = crowd.field_items[k];
+            if (item >= 0 && crowd.claimed[item >> 6] >> (item & 63) & 1)
+                f = (int)k;
+        }
+        if (f < 0)
+            break;
+        if (crowd.field_items[f] >= 0)
+            crowd.item_fields[crowd.field_items[f]] = -1;
+        crowd.field_items[f] = id;
+        crowd.item_fields[id] = f;
+        crowd.building.push_back(f);
+    }
+
+    if (!crowd.building.empty()) {
+        crowd.queues.resize(std::max(crowd.queues.size(), crowd.building.size()));
+        std::function<void(int, int)> build_fields = [&](int begin, int end) {
+            for (int k = begin; k < end; ++k) {
+                int f = crowd.building[k];
+                build_crowd_field(maze.grid, crowd_item_room(maze, crowd.field_items[f]), crowd.fields[f], crowd.queues[k]);
+            }
+        };
+        if (pool)
+            pool->parallel_for((int)crowd.building.size(), 1, build_fields);
+        else
+            build_fields(0, (int)crowd.building.size());
+        for (std::size_t k = 0; k < crowd.building.size(); ++k)
+            crowd.stale[crowd.building[k]] = 0;
+    }
+
+    crowd.open_items.clear();
+    for (int id = 0; id < maze.total_collectables; ++id)
+        if (!(crowd.claimed[id >> 6] >> (id & 63) & 1) && crowd.item_fields[id] >= 0)
+            crowd.open_items.push_back(id);
+}
+
+
+// Stepping the whole crowd by dt seconds: the agents move, the arrivals claim their items in agent order, then the
+// fields missing are built. Returns the items claimed during the step
+inline int step_crowd(maze_crowd &crowd, float dt) {
+    const maze_model &maze = *crowd.maze;
+    // Paged grids are read through a cache that is not thread-safe
+    ThreadPool *pool = maze.grid.cells.paged() ? nullptr : crowd.pool;
+    if (pool)
+        pool->parallel_for(crowd.agents, CROWD_CHUNK, [&](int begin, int end) { step_agents(crowd, begin, end, dt); });
+    else
+        step_agents(crowd, 0, crowd.agents, dt);
+
+    int claims = 0;
+    for (int a = 0; a < crowd.agents; ++a) {
+        if (!crowd.arrived[a])
+            continue;
+        crowd.arrived[a] = 0;
+        int id = crowd.target[a];
+        crowd.target[a] = -1;
+        if (crowd.claimed[id >> 6] >> (id & 63) & 1)
+            continue;
+        crowd.claimed[id >> 6] |= (std::uint64_t)1 << (id & 63);
+        ++crowd.collectables[a];
+        ++claims;
+        // Every item claimed, a new round
+        if (++crowd.claimed_count == maze.total_collectables) {
+            std::fill(crowd.claimed.begin(), crowd.claimed.end(), 0);
+            crowd.claimed_count = 0;
+        }
+    }
+    crowd.claims += claims;
+
+    if (crowd.agents > 0)
+        update_crowd_fields(crowd, pool);
+    return claims;
+}
+
+
+// Agents standing on a layer, for an instanced draw: appends their world position (x, z) to instances and
+// returns how many there are
+inline int crowd_instances(const maze_crowd &crowd, int layer, std::vector<float> &instances) {
+    int count = 0;
+    for (int a = 0; a < crowd.agents; ++a) {
+        if (crowd.layer[a] != layer)
+            continue;
+        instances.push_back(crowd.position_x[a]);
+        instances.push_back(crowd.position_z[a]);
+        ++count;
+    }
+    return count;
+}
+#endif
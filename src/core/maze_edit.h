@@ -0,0 +1,70 @@
+#ifndef MAZE_EDIT_H
+#define MAZE_EDIT_H
+
+#include <cstdint>
+
+#include "maze_model.h"
+
+
+// Rooms edited at runtime (doors, timed gates): the type of one room changes and only what depends on it is
+// derived again. edit_room() rewrites the walls of the room and of its four neighbours (the same rule as
+// derive_walls()); the caches built from the cells follow with their own update, given the edited room:
+// update_block_masks (bitmask BFS), update_jump_table (JPS+) and update_cluster_graph (HPA*). The renderer only
+// needs the rows of the room and its neighbours (row - 1 to row + 1).
+
+typedef struct room_edit {
+    int layer;
+    int column;
+    int row;
+    int previous_type;
+    int type;
+}room_edit;
+
+
+// Walls of one room from its type and its neighbours: every side of a wall room is closed, other sides are closed
+// when the room beyond is a wall or outside the layer
+inline void derive_room_walls(maze_grid &grid, int layer, int column, int row) {
+    if (!inside_grid(grid, layer, column, row))
+        return;
+    std::uint8_t &cell = grid.cells[grid_index(grid, layer, column, row)];
+    int walls = 0;
+    if (cell_type_of(cell) == 1)
+        walls = ALL_WALLS;
+    else {
+        const int columns[4] = {-1, 1, 0, 0};
+        const int rows[4] = {0, 0, -1, 1};
+        for (int side = 0; side < 4; ++side) {
+            int c = column + columns[side], r = row + rows[side];
+            if (!inside_grid(grid, layer, c, r) || cell_type(grid, layer, c, r) == 1)
+                walls |= 1 << side;
+        }
+    }
+    cell = (std::uint8_t)((cell & 0x0F) | walls << 4);
+}
+
+
+// Changing the type of a room to an empty room, a wall or an elevator (0 to 3), and the walls around it.
+// The start room and rooms holding an item are left alone (false). edit (optional) receives the change
+inline bool edit_room(maze_model &maze, int layer, int column, int row, int type, room_edit *edit = nullptr) {
+    maze_grid &grid = maze.grid;
+    if (!inside_grid(grid, layer, column, row) || type < 0 || type > 3)
+        return false;
+    int previous_type = cell_type(grid, layer, column, row);
+    if (previous_type == -1 || previous_type == 4)
+        return false;
+    if (edit) {
+        room_edit change = {layer, column, row, previous_type, type};
+        *edit = change;
+    }
+    if (previous_type == type)
+        return true;
+
+    set_cell_type(grid, layer, column, row, type);
+    derive_room_walls(grid, layer, column, row);
+    derive_room_walls(grid, layer, column - 1, row);
+    derive_room_walls(grid, layer, column + 1, row);
+    derive_room_walls(grid, layer, column, row - 1);
+    derive_room_walls(grid, layer, column, row + 1);
+    return true;
+}
+#endif
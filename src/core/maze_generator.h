@@ -0,0 +1,336 @@
+#ifndef MAZE_GENERATOR_H
+#define MAZE_GENERATOR_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "maze_binary.h"
+
+
+// Synthetic mazes for load testing, generated a row at a time with Eller's algorithm: the rooms of a grid row are
+// tagged with sets, neighbours of different sets are joined at random, every set goes down at least once and the
+// last row joins what is left, so a floor is a perfect maze (one route between two rooms) built in O(width) memory.
+// Braided mazes then open a side of some dead ends (left, right or front, the rows above are already written).
+// In the grid, the maze rooms are at odd columns and rows and the rooms between them are the open sides (or walls).
+// Elevators come in pairs, up on a floor and down on the floor above at the same room; the pairs between floors
+// l and l + 1 only use maze rooms whose column + row + l is even, so a room never holds two elevators. Collectables
+// are spread evenly over the floors. Every floor only depends on the seed and its number, floors are generated on
+// the pool threads and written straight to their place in the file (text: one character per room, binary: with
+// the walls and the collectable index), so the output is the same whatever the number of threads.
+
+typedef struct maze_generator_options {
+    int width;                  // Grid size, rooms and walls (odd sizes, even ones end with a row / column of walls)
+    int height;
+    int layers;
+    double braid;               // Share of the dead ends opened (0: perfect maze)
+    double elevators;           // Share of the maze rooms of a floor holding an elevator pair to the floor above
+    long long collectables;
+    std::uint64_t seed;
+}maze_generator_options;
+
+const std::uint8_t GENERATED_START = 0x0F;     // Cell type of the start room (-1), room (1, 1) of layer 0
+
+
+// Random numbers of the generator (splitmix64), the same on every platform
+inline std::uint64_t generator_next(std::uint64_t &state) {
+    std::uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+inline double generator_uniform(std::uint64_t &state) {
+    return (generator_next(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Whether the maze room (column, row) holds an elevator pair from floor layer to the floor above
+inline bool elevator_pair(const maze_generator_options &options, int layer, int column, int row) {
+    if (layer < 0 || layer + 1 >= options.layers || ((column + row + layer) & 1) || (layer == 0 && column == 0 && row == 0))
+        return false;
+    std::uint64_t state = options.seed ^ ((std::uint64_t)layer << 48 ^ (std::uint64_t)row << 24 ^ (std::uint64_t)column) * 0xD1B54A32D192ED03ull;
+    return generator_uniform(state) < options.elevators;
+}
+
+// Random state a floor starts from
+inline std::uint64_t layer_state(const maze_generator_options &options, int layer) {
+    return options.seed ^ (std::uint64_t)(layer + 1) * 0x9E3779B97F4A7C15ull;
+}
+
+
+// Maze rooms of a floor holding a collectable (row * columns + column, sorted), never the start room or an elevator.
+// The floor's share of the collectables, at most half of its rooms (fewer when the rooms left are hard to find)
+inline std::vector<std::uint64_t> collectable_rooms(const maze_generator_options &options, int layer, int columns, int rows, std::uint64_t &state) {
+    std::uint64_t rooms = (std::uint64_t)columns * rows;
+    long long share = options.collectables / options.layers + (layer < options.collectables % options.layers ? 1 : 0);
+    std::uint64_t count = std::min<std::uint64_t>((std::uint64_t)std::max(share, 0ll), rooms / 2);
+    std::vector<std::uint64_t> picked;
+    for (std::uint64_t attempts = 0; picked.size() < count && attempts < 64 * count + 1024; ) {
+        while (picked.size() < count && attempts++ < 64 * count + 1024) {
+            std::uint64_t room = generator_next(state) % rooms;
+            int column = (int)(room % columns), row = (int)(room / columns);
+            if ((layer == 0 && room == 0) || elevator_pair(options, layer, column, row) || elevator_pair(options, layer - 1, column, row))
+                continue;
+            picked.push_back(room);
+        }
+        std::sort(picked.begin(), picked.end());
+        picked.erase(std::unique(picked.begin(), picked.end()), picked.end());
+    }
+    return picked;
+}
+
+
+// Generating one floor: emit(row, types) receives every grid row in order (room types only, the start room as
+// GENERATED_START). Memory is a few arrays of the maze width
+inline void generate_layer(const maze_generator_options &options, int layer, const std::function<void(int, const std::uint8_t*)> &emit) {
+    int columns = std::max((options.width - 1) / 2, 1), rows = std::max((options.height - 1) / 2, 1);
+    std::uint64_t state = layer_state(options, layer);
+    std::vector<std::uint64_t> items = collectable_rooms(options, layer, columns, rows, state);
+    std::size_t next_item = 0;
+
+    std::vector<std::uint32_t> sets(columns), parents(2 * columns), counts(2 * columns), carried(2 * columns);
+    std::vector<std::uint8_t> right(columns), down(columns), above(columns, 0), room_row(options.width), side_row(options.width);
+    std::function<std::uint32_t(std::uint32_t)> root = [&](std::uint32_t s) {
+        while (parents[s] != s)
+            s = parents[s] = parents[parents[s]];
+        return s;
+    };
+    std::fill(room_row.begin(), room_row.end(), 1);
+    emit(0, room_row.data());
+
+    for (int r = 0; r < rows; ++r) {
+        bool last = r + 1 == rows;
+        // Sets of the rooms, numbered again from 0: the ones coming from above keep theirs, the others are new
+        std::fill(carried.begin(), carried.end(), 0xFFFFFFFFu);
+        std::uint32_t used = 0;
+        for (int c = 0; c < columns; ++c) {
+            std::uint32_t s;
+            if (above[c]) {
+                std::uint32_t old = root(sets[c]);
+                if (carried[old] == 0xFFFFFFFFu)
+                    carried[old] = used++;
+                s = carried[old];
+            }
+            else
+                s = 0xFFFFFFFFu;
+            sets[c] = s;
+        }
+        for (int c = 0; c < columns; ++c)
+            if (sets[c] == 0xFFFFFFFFu)
+                sets[c] = used++;
+        for (std::uint32_t s = 0; s < used; ++s)
+            parents[s] = s;
+
+        // Joining neighbours of different sets (all of them on the last row)
+        for (int c = 0; c + 1 < columns; ++c) {
+            std::uint32_t a = root(sets[c]), b = root(sets[c + 1]);
+            right[c] = a != b && (last || generator_uniform(state) < 0.5);
+            if (right[c])
+                parents[std::max(a, b)] = std::min(a, b);
+        }
+        right[columns - 1] = 0;
+
+        // Going down, at least once per set
+        std::fill(counts.begin(), counts.begin() + used, 0);
+        std::fill(carried.begin(), carried.begin() + used, 0);
+        for (int c = 0; c < columns; ++c)
+            ++counts[root(sets[c])];
+        for (int c = 0; c < columns; ++c) {
+            std::uint32_t s = root(sets[c]);
+            down[c] = !last && (generator_uniform(state) < 0.5 || (counts[s] == 1 && !carried[s]));
+            carried[s] |= down[c];
+            --counts[s];
+        }
+
+        // Braiding: a dead end opens one of its closed sides that leads to a room
+        if (options.braid > 0.0) {
+            for (int c = 0; c < columns; ++c) {
+                bool left = c > 0 && right[c - 1];
+                if (left + right[c] + above[c] + down[c] != 1 || generator_uniform(state) >= options.braid)
+                    continue;
+                int sides[3], count = 0;
+                if (c > 0 && !left)
+                    sides[count++] = 0;
+                if (c + 1 < columns && !right[c])
+                    sides[count++] = 1;
+                if (!last && !down[c])
+                    sides[count++] = 2;
+                if (count == 0)
+                    continue;
+                int side = sides[generator_next(state) % count];
+                if (side == 2) {
+                    down[c] = 1;
+                    continue;
+                }
+                int c2 = side == 0 ? c - 1 : c;
+                right[c2] = 1;
+                std::uint32_t a = root(sets[c2]), b = root(sets[c2 + 1]);
+                if (a != b)
+                    parents[std::max(a, b)] = std::min(a, b);
+            }
+        }
+
+        // Grid rows: the rooms and the sides between them, then the sides going down
+        std::fill(room_row.begin(), room_row.end(), 1);
+        std::fill(side_row.begin(), side_row.end(), 1);
+        for (int c = 0; c < columns; ++c) {
+            std::uint8_t type = 0;
+            if (layer == 0 && r == 0 && c == 0)
+                type = GENERATED_START;
+            else if (elevator_pair(options, layer, c, r))
+                type = 2;
+            else if (elevator_pair(options, layer - 1, c, r))
+                type = 3;
+            std::uint64_t room = (std::uint64_t)r * columns + c;
+            if (next_item < items.size() && items[next_item] == room) {
+                type = 4;
+                ++next_item;
+            }
+            if (2 * c + 1 < options.width) {
+                room_row[2 * c + 1] = type;
+                if (right[c] && 2 * c + 2 < options.width)
+                    room_row[2 * c + 2] = 0;
+                if (down[c])
+                    side_row[2 * c + 1] = 0;
+            }
+        }
+        if (2 * r + 1 < options.height)
+            emit(2 * r + 1, room_row.data());
+        if (2 * r + 2 < options.height)
+            emit(2 * r + 2, side_row.data());
+        std::copy(down.begin(), down.end(), above.begin());
+    }
+    std::fill(room_row.begin(), room_row.end(), 1);
+    for (int r = 2 * rows + 1; r < options.height; ++r)
+        emit(r, room_row.data());
+}
+
+
+// Walls of a row from the types of the row and of the rows around it (null outside the layer), as derive_walls()
+inline void derive_row_walls(const std::uint8_t *back, const std::uint8_t *row, const std::uint8_t *front, int width, std::uint8_t *out) {
+    for (int c = 0; c < width; ++c) {
+        int type = cell_type_of(row[c]), walls = ALL_WALLS;
+        if (type != 1) {
+            walls = 0;
+            if (c == 0 || cell_type_of(row[c - 1]) == 1) walls |= WALL_LEFT;
+            if (c + 1 == width || cell_type_of(row[c + 1]) == 1) walls |= WALL_RIGHT;
+            if (!back || cell_type_of(back[c]) == 1) walls |= WALL_BACK;
+            if (!front || cell_type_of(front[c]) == 1) walls |= WALL_FRONT;
+        }
+        out[c] = (std::uint8_t)((row[c] & 0x0F) | walls << 4);
+    }
+}
+
+
+// Generating a maze in memory, the floors on the pool threads
+inline void generate_maze(maze_model &maze, const maze_generator_options &options, ThreadPool *pool = nullptr) {
+    resize_grid(maze.grid, options.width, options.height, options.layers);
+    std::function<void(int, int)> generate = [&](int begin, int end) {
+        for (int layer = begin; layer < end; ++layer)
+            generate_layer(options, layer, [&](int row, const std::uint8_t *types) {
+                std::memcpy(maze.grid.cells.data() + grid_index(maze.grid, layer, 0, row), types, options.width);
+            });
+    };
+    if (pool)
+        pool->parallel_for(options.layers, 1, generate);
+    else
+        generate(0, options.layers);
+    maze.initial_element_position = std::make_pair(1, 1);
+    derive_walls(maze.grid, pool);
+    index_collectables(maze);
+}
+
+
+// Generating a maze straight into a file, text (the format load_maze() reads, one character per room so every
+// row has its place) or binary (walls and collectable index included). Every floor is written by its own thread
+// with a window of three grid rows
+inline bool write_generated_maze(const maze_generator_options &options, const char *file_name, bool binary, ThreadPool *pool = nullptr) {
+    if (options.width < 3 || options.height < 3 || options.layers < 1)
+        return false;
+    // Collectables before every floor, in the binary index
+    std::vector<std::uint64_t> first_item(options.layers + 1, 0);
+    int columns = (options.width - 1) / 2, rows = (options.height - 1) / 2;
+    for (int layer = 0; layer < options.layers; ++layer) {
+        std::uint64_t state = layer_state(options, layer);
+        first_item[layer + 1] = first_item[layer] + collectable_rooms(options, layer, columns, rows, state).size();
+    }
+    std::uint64_t total = first_item[options.layers];
+
+    // Header, then every floor at its offset
+    std::string text_header = "maze " + std::to_string(options.width) + " " + std::to_string(options.height) + " " + std::to_string(options.layers) + "\n";
+    maze_binary_header header = binary_header(options.width, options.height, options.layers, std::make_pair(1, 1), (std::uint32_t)total, BINARY_WALLS | BINARY_COLLECTABLES);
+    std::uint64_t layer_bytes = binary ? (std::uint64_t)options.width * options.height : (std::uint64_t)options.height * options.width * 2 + 1;
+    std::uint64_t first_layer = binary ? header.cells_offset : text_header.size();
+    {
+        std::ofstream file(file_name, std::ios::binary | std::ios::trunc);
+        if (!file)
+            return false;
+        if (binary) {
+            char padding[MAZE_BINARY_HEADER_SIZE] = {0};
+            file.write((const char*)&header, sizeof(header));
+            file.write(padding, MAZE_BINARY_HEADER_SIZE - sizeof(header));
+            // Full size up front (the floors write their parts anywhere in it)
+            file.seekp((std::streamoff)(header.collectables_offset + total * sizeof(std::uint64_t) - 1));
+            file.put(0);
+        }
+        else
+            file << text_header;
+        if (!file)
+            return false;
+    }
+
+    std::vector<std::uint8_t> written(options.layers, 0);
+    std::function<void(int, int)> write = [&](int begin, int end) {
+        for (int layer = begin; layer < end; ++layer) {
+            std::fstream file(file_name, std::ios::binary | std::ios::in | std::ios::out);
+            file.seekp((std::streamoff)(first_layer + layer * layer_bytes));
+            std::vector<std::uint8_t> window(3 * (std::size_t)options.width), out(2 * (std::size_t)options.width);
+            std::vector<std::uint64_t> items;
+            int rows_seen = 0;
+            // A row is written once the next one is known (its front walls)
+            std::function<void(int, const std::uint8_t*)> write_row = [&](int row, const std::uint8_t *front) {
+                const std::uint8_t *current = &window[(std::size_t)(row % 3) * options.width];
+                const std::uint8_t *back = row > 0 ? &window[(std::size_t)((row + 2) % 3) * options.width] : nullptr;
+                if (binary) {
+                    derive_row_walls(back, current, front, options.width, out.data());
+                    file.write((const char*)out.data(), options.width);
+                }
+                else {
+                    for (int c = 0; c < options.width; ++c) {
+                        out[2 * c] = current[c] == GENERATED_START ? 'x' : (std::uint8_t)('0' + current[c]);
+                        out[2 * c + 1] = c + 1 < options.width ? ' ' : '\n';
+                    }
+                    file.write((const char*)out.data(), 2 * options.width);
+                }
+                for (int c = 0; c < options.width; ++c)
+                    if (current[c] == 4)
+                        items.push_back(((std::uint64_t)layer * options.height + row) * options.width + c);
+            };
+            generate_layer(options, layer, [&](int row, const std::uint8_t *types) {
+                std::memcpy(&window[(std::size_t)(row % 3) * options.width], types, options.width);
+                if (row > 0)
+                    write_row(row - 1, types);
+                rows_seen = row + 1;
+            });
+            write_row(rows_seen - 1, nullptr);
+            if (!binary)
+                file.put('\n');
+            else if (!items.empty()) {
+                file.seekp((std::streamoff)(header.collectables_offset + first_item[layer] * sizeof(std::uint64_t)));
+                file.write((const char*)items.data(), items.size() * sizeof(std::uint64_t));
+            }
+            written[layer] = (bool)file;
+        }
+    };
+    if (pool)
+        pool->parallel_for(options.layers, 1, write);
+    else
+        write(0, options.layers);
+    return std::find(written.begin(), written.end(), 0) == written.end();
+}
+#endif
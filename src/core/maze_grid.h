@@ -0,0 +1,454 @@
+#ifndef MAZE_GRID_H
+#define MAZE_GRID_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MAZE_SSE2
+#endif
+
+#include "../dependencies/GLM/glm.hpp"
+#include "../dependencies/UTILS/thread_pool.h"
+#include "paged_cells.h"
+
+
+// Bytes of a grid: owned, pointing into a memory-mapped file that the buffer keeps alive, or paged
+// (loaded chunk by chunk under a memory budget, data() is then null and only operator[] reaches the cells).
+// Copies never share changes with the original: mapped bytes are copied, paged cells get their own cache
+class CellBuffer {
+    private:
+        std::vector<std::uint8_t> owned;
+        std::shared_ptr<void> mapping;
+        std::shared_ptr<PagedCells> pages;
+        std::uint8_t *bytes;
+        std::size_t count;
+
+        // Moving mapped or paged bytes into owned storage before changing the size
+        void own() {
+            if (pages) {
+                owned.resize(count);
+                for (std::size_t i = 0; i < count; ++i)
+                    owned[i] = pages->at(i, false);
+                pages.reset();
+            }
+            else if (mapping)
+                owned.assign(bytes, bytes + count);
+            mapping.reset();
+        }
+    public:
+        CellBuffer() : bytes(nullptr), count(0) {}
+        CellBuffer(const CellBuffer &other) : bytes(nullptr), count(other.count) {
+            if (other.pages)
+                pages = std::make_shared<PagedCells>(*other.pages);
+            else {
+                owned.assign(other.bytes, other.bytes + other.count);
+                bytes = owned.data();
+            }
+        }
+        CellBuffer(CellBuffer &&other) noexcept : owned(std::move(other.owned)), mapping(std::move(other.mapping)), pages(std::move(other.pages)), bytes(other.bytes), count(other.count) {
+            other.bytes = nullptr;
+            other.count = 0;
+        }
+        CellBuffer& operator=(CellBuffer other) {
+            owned.swap(other.owned);
+            mapping.swap(other.mapping);
+            pages.swap(other.pages);
+            std::swap(bytes, other.bytes);
+            std::swap(count, other.count);
+            return *this;
+        }
+
+        // Using count bytes that live inside a mapping (kept alive by the shared pointer)
+        void map(std::shared_ptr<void> keep_alive, std::uint8_t *data, std::size_t size) {
+            owned.clear();
+            owned.shrink_to_fit();
+            pages.reset();
+            mapping = keep_alive;
+            bytes = data;
+            count = size;
+        }
+        bool mapped() const {
+            return (bool)mapping;
+        }
+
+        // Reaching size cells through a chunk cache
+        void page(std::shared_ptr<PagedCells> paged_cells, std::size_t size) {
+            owned.clear();
+            owned.shrink_to_fit();
+            mapping.reset();
+            pages = paged_cells;
+            bytes = nullptr;
+            count = size;
+        }
+        PagedCells* paged() const {
+            return pages.get();
+        }
+
+        void assign(std::size_t size, std::uint8_t value) {
+            mapping.reset();
+            pages.reset();
+            owned.assign(size, value);
+            bytes = owned.data();
+            count = size;
+        }
+        void resize(std::size_t size) {
+            own();
+            owned.resize(size);
+            bytes = owned.data();
+            count = size;
+        }
+        void reserve(std::size_t size) {
+            own();
+            owned.reserve(size);
+            bytes = owned.data();
+        }
+        void clear() {
+            assign(0, 0);
+        }
+
+        std::size_t size() const {
+            return count;
+        }
+        std::uint8_t* data() {
+            return bytes;
+        }
+        const std::uint8_t* data() const {
+            return bytes;
+        }
+        std::uint8_t& operator[](std::size_t i) {
+            if (pages)
+                return pages->at(i, true);
+            return bytes[i];
+        }
+        const std::uint8_t& operator[](std::size_t i) const {
+            if (pages)
+                return pages->at(i, false);
+            return bytes[i];
+        }
+};
+
+
+// Compact maze storage: one byte per room, no size limits.
+// Low nibble: room type (-1 start is stored as 0xF), high nibble: wall mask derived from the neighbours.
+// Room positions are not stored, they follow from the (column, row) indices.
+// Layers are stored one after the other, each one row-major or in square tiles (rooms of a tile are
+// contiguous, so the rooms above and below are close in memory). grid_index() hides the layout.
+
+enum wall_bits { WALL_LEFT = 1, WALL_RIGHT = 2, WALL_BACK = 4, WALL_FRONT = 8 };  // -X, +X, -Z, +Z (walls[0..3])
+const int ALL_WALLS = WALL_LEFT | WALL_RIGHT | WALL_BACK | WALL_FRONT;
+const std::uint8_t WALL_CELL = (std::uint8_t)(1 | ALL_WALLS << 4);
+
+enum grid_layouts { LAYOUT_ROW_MAJOR = 0, LAYOUT_TILES_8 = 3, LAYOUT_TILES_16 = 4 };  // Value: log2 of the tile side
+
+typedef struct maze_grid {
+    int width;      // Columns per layer
+    int height;     // Rows per layer
+    int layers;
+    int tile_shift;                     // grid_layouts, 0 when row-major
+    int tile_columns;                   // Tiles per tile row (tiled layouts)
+    std::size_t layer_size;             // Cells per layer (tiled layers are padded to whole tiles, with walls)
+    CellBuffer cells;                   // layers * layer_size
+}maze_grid;
+
+
+// Setting the dimensions of a row-major grid (the cells are left untouched)
+inline void set_grid_size(maze_grid &grid, int width, int height, int layers) {
+    grid.width = width;
+    grid.height = height;
+    grid.layers = layers;
+    grid.tile_shift = LAYOUT_ROW_MAJOR;
+    grid.tile_columns = 0;
+    grid.layer_size = (std::size_t)width * height;
+}
+
+// Allocating a grid of walls
+inline void resize_grid(maze_grid &grid, int width, int height, int layers) {
+    set_grid_size(grid, width, height, layers);
+    grid.cells.assign(grid.layer_size * layers, WALL_CELL);
+}
+
+// Position of a room inside its layer
+inline std::size_t layer_offset(int width, int tile_shift, int tile_columns, int column, int row) {
+    if (tile_shift == LAYOUT_ROW_MAJOR)
+        return (std::size_t)row * width + column;
+    int mask = (1 << tile_shift) - 1;
+    std::size_t tile = (std::size_t)(row >> tile_shift) * tile_columns + (column >> tile_shift);
+    return (tile << (2 * tile_shift)) + ((row & mask) << tile_shift) + (column & mask);
+}
+
+inline std::size_t grid_index(const maze_grid &grid, int layer, int column, int row) {
+    return (std::size_t)layer * grid.layer_size + layer_offset(grid.width, grid.tile_shift, grid.tile_columns, column, row);
+}
+
+// Room of a grid index (inverse of grid_index)
+inline void index_position(const maze_grid &grid, std::size_t index, int &layer, int &column, int &row) {
+    layer = (int)(index / grid.layer_size);
+    std::size_t offset = index - (std::size_t)layer * grid.layer_size;
+    if (grid.tile_shift == LAYOUT_ROW_MAJOR) {
+        row = (int)(offset / grid.width);
+        column = (int)(offset - (std::size_t)row * grid.width);
+        return;
+    }
+    int mask = (1 << grid.tile_shift) - 1;
+    std::size_t tile = offset >> (2 * grid.tile_shift);
+    row = (int)(tile / grid.tile_columns) << grid.tile_shift | (int)(offset >> grid.tile_shift & mask);
+    column = (int)(tile % grid.tile_columns) << grid.tile_shift | (int)(offset & mask);
+}
+
+inline bool inside_grid(const maze_grid &grid, int layer, int column, int row) {
+    return layer >= 0 && layer < grid.layers && column >= 0 && column < grid.width && row >= 0 && row < grid.height;
+}
+
+// Type stored in a cell byte (the nibble is sign-extended so 0xF reads back as -1)
+inline int cell_type_of(std::uint8_t cell) {
+    return (int)(std::int8_t)(cell << 4) >> 4;
+}
+
+inline int cell_type(const maze_grid &grid, int layer, int column, int row) {
+    return cell_type_of(grid.cells[grid_index(grid, layer, column, row)]);
+}
+
+inline int cell_walls(const maze_grid &grid, int layer, int column, int row) {
+    return grid.cells[grid_index(grid, layer, column, row)] >> 4;
+}
+
+// Only the type changes, call derive_walls() (or update the neighbours) afterwards if walls moved
+inline void set_cell_type(maze_grid &grid, int layer, int column, int row, int type) {
+    std::uint8_t &cell = grid.cells[grid_index(grid, layer, column, row)];
+    cell = (std::uint8_t)((cell & 0xF0) | (type & 0x0F));
+}
+
+// Non-owning view of one layer (in the grid layout), read in place without copying.
+// Paged grids have no cell pointer, the view then reads through the buffer
+typedef struct layer_view {
+    const std::uint8_t *cells;
+    int width;
+    int height;
+    int tile_shift;
+    int tile_columns;
+    const CellBuffer *buffer;
+    std::size_t first;              // Grid index of the first cell of the layer
+}layer_view;
+
+// View of row-major cells (width * height)
+inline layer_view make_layer_view(const std::uint8_t *cells, int width, int height) {
+    layer_view view = {cells, width, height, LAYOUT_ROW_MAJOR, 0, nullptr, 0};
+    return view;
+}
+
+// Valid until the grid is resized, reloaded or changes layout
+inline layer_view view_layer(const maze_grid &grid, int layer) {
+    std::size_t first = (std::size_t)layer * grid.layer_size;
+    const std::uint8_t *cells = grid.cells.paged() ? nullptr : grid.cells.data() + first;
+    layer_view view = {cells, grid.width, grid.height, grid.tile_shift, grid.tile_columns, &grid.cells, first};
+    return view;
+}
+
+inline std::uint8_t view_cell(const layer_view &view, int column, int row) {
+    std::size_t offset = layer_offset(view.width, view.tile_shift, view.tile_columns, column, row);
+    if (!view.cells)
+        return (*view.buffer)[view.first + offset];
+    return view.cells[offset];
+}
+
+inline int view_type(const layer_view &view, int column, int row) {
+    return cell_type_of(view_cell(view, column, row));
+}
+
+// Copying rows [first, end) of a view in row-major order (width bytes per row, from out on)
+inline void copy_layer_rows(const layer_view &view, int first, int end, std::uint8_t *out) {
+    if (view.cells && view.tile_shift == LAYOUT_ROW_MAJOR) {
+        std::copy(view.cells + (std::size_t)first * view.width, view.cells + (std::size_t)end * view.width, out);
+        return;
+    }
+    if (!view.cells && view.tile_shift == LAYOUT_ROW_MAJOR) {
+        // Paged rows are copied chunk by chunk
+        std::size_t first_row = view.first / view.width;
+        for (int i = first; i < end; ++i)
+            view.buffer->paged()->read_row(first_row + i, 0, view.width, out + (std::size_t)(i - first) * view.width);
+        return;
+    }
+    for (int i = first; i < end; ++i)
+        for (int j = 0; j < view.width; ++j)
+            *out++ = view_cell(view, j, i);
+}
+
+// Copying the cells of a view in row-major order (width * height bytes)
+inline void copy_layer(const layer_view &view, std::uint8_t *out) {
+    copy_layer_rows(view, 0, view.height, out);
+}
+
+
+// Storing the grid in another layout (grid_layouts), the rooms are moved, the walls are kept
+inline void set_grid_layout(maze_grid &grid, int tile_shift) {
+    if (tile_shift == grid.tile_shift)
+        return;
+    maze_grid target;
+    set_grid_size(target, grid.width, grid.height, grid.layers);
+    if (tile_shift != LAYOUT_ROW_MAJOR) {
+        int side = 1 << tile_shift;
+        int tile_rows = (grid.height + side - 1) >> tile_shift;
+        target.tile_shift = tile_shift;
+        target.tile_columns = (grid.width + side - 1) >> tile_shift;
+        target.layer_size = ((std::size_t)target.tile_columns * tile_rows) << (2 * tile_shift);
+    }
+    target.cells.assign(target.layer_size * grid.layers, WALL_CELL);
+
+    for (int l = 0; l < grid.layers; ++l) {
+        layer_view source = view_layer(grid, l);
+        std::uint8_t *destination = target.cells.data() + (std::size_t)l * target.layer_size;
+        for (int i = 0; i < grid.height; ++i)
+            for (int j = 0; j < grid.width; ++j)
+                destination[layer_offset(target.width, target.tile_shift, target.tile_columns, j, i)] = view_cell(source, j, i);
+    }
+    grid = std::move(target);
+}
+
+
+// Keeping the cells run-length encoded in memory, decoded chunk by chunk on access (at most memory_budget bytes
+// of decoded chunks). Worth it for grids with long runs of identical rooms (wall regions, corridors)
+inline void compress_grid(maze_grid &grid, std::size_t memory_budget) {
+    set_grid_layout(grid, LAYOUT_ROW_MAJOR);
+    std::shared_ptr<RunLengthRows> rows = std::make_shared<RunLengthRows>();
+    const CellBuffer &cells = grid.cells;
+    rows->encode((std::size_t)grid.layers * grid.height, grid.width, [&](std::size_t r, std::uint8_t *out) {
+        for (int j = 0; j < grid.width; ++j)
+            out[j] = cells[r * grid.width + j];
+    });
+    std::shared_ptr<PagedCells> pages = std::make_shared<PagedCells>(rows, grid.width, grid.height, grid.layers, memory_budget);
+    grid.cells.page(pages, grid.cells.size());
+}
+
+
+// Loading the cells around a room, and ahead of it along a direction, of a paged grid (nothing otherwise)
+inline void prefetch_cells(maze_grid &grid, int layer, int column, int row, float direction_x, float direction_z) {
+    const int reach = 2;
+    if (grid.cells.paged() && grid.tile_shift == LAYOUT_ROW_MAJOR)
+        grid.cells.paged()->prefetch(layer, column, row, direction_x, direction_z, reach);
+}
+
+
+// Room center in maze units (multiply by the room size for world units)
+inline glm::vec3 cell_position(int column, int row) {
+    return glm::vec3((float)column, 0.0f, (float)row);
+}
+
+
+// Wall rooms (type 1) of one grid row as a bitmask, bit j of word j / 64 is column j.
+// Bits past the last column are set, so the layer border reads as a wall
+inline void wall_row_mask(const std::uint8_t *row, int width, std::uint64_t *mask) {
+    int words = (width + 63) / 64;
+    for (int w = 0; w < words; ++w)
+        mask[w] = 0;
+    int j = 0;
+#ifdef MAZE_SSE2
+    const __m128i low = _mm_set1_epi8(0x0F), wall = _mm_set1_epi8(1);
+    for (; j + 16 <= width; j += 16) {
+        __m128i types = _mm_and_si128(_mm_loadu_si128((const __m128i*)(row + j)), low);
+        mask[j >> 6] |= (std::uint64_t)(_mm_movemask_epi8(_mm_cmpeq_epi8(types, wall)) & 0xFFFF) << (j & 63);
+    }
+#endif
+    for (; j < width; ++j)
+        mask[j >> 6] |= (std::uint64_t)((row[j] & 0x0F) == 1) << (j & 63);
+    if (width & 63)
+        mask[words - 1] |= ~(std::uint64_t)0 << (width & 63);
+}
+
+
+#ifdef MAZE_SSE2
+// 16 bytes, byte k is value when bit k is set and 0 otherwise
+inline __m128i expand_bits(std::uint16_t bits, int value) {
+    const __m128i select = _mm_set_epi8((char)128, 64, 32, 16, 8, 4, 2, 1, (char)128, 64, 32, 16, 8, 4, 2, 1);
+    __m128i spread = _mm_unpacklo_epi64(_mm_set1_epi8((char)(bits & 0xFF)), _mm_set1_epi8((char)(bits >> 8)));
+    __m128i set = _mm_cmpeq_epi8(_mm_and_si128(spread, select), select);
+    return _mm_and_si128(set, _mm_set1_epi8((char)value));
+}
+#endif
+
+
+// Defining the walls of grid rows [begin, end) (row r is row r % height of layer r / height) from the row masks.
+// A side is open when the room is walkable and the neighbour on that side is not a wall:
+// the four sides are the wall mask shifted by one column (left, right) and the masks of the rows above and below
+inline void derive_wall_rows(maze_grid &grid, const std::vector<std::uint64_t> &masks, int words, int begin, int end) {
+    const std::uint64_t all = ~(std::uint64_t)0;
+    for (int r = begin; r < end; ++r) {
+        int i = r % grid.height;
+        const std::uint64_t *current = &masks[(std::size_t)r * words];
+        const std::uint64_t *back = i > 0 ? current - words : nullptr;
+        const std::uint64_t *front = i + 1 < grid.height ? current + words : nullptr;
+        std::uint8_t *row = grid.cells.data() + (std::size_t)r * grid.width;
+
+        for (int w = 0; w < words; ++w) {
+            std::uint64_t wall = current[w];
+            std::uint64_t left = (wall << 1) | (w > 0 ? current[w - 1] >> 63 : 1);
+            std::uint64_t right = (wall >> 1) | ((w + 1 < words ? current[w + 1] : all) << 63);
+            std::uint64_t back_wall = back ? back[w] : all;
+            std::uint64_t front_wall = front ? front[w] : all;
+
+            int first = w * 64;
+            int count = std::min(64, grid.width - first);
+            int k = 0;
+#ifdef MAZE_SSE2
+            const __m128i low = _mm_set1_epi8(0x0F);
+            for (; k + 16 <= count; k += 16) {
+                __m128i walls = _mm_or_si128(_mm_or_si128(expand_bits((std::uint16_t)(left >> k), WALL_LEFT << 4), expand_bits((std::uint16_t)(right >> k), WALL_RIGHT << 4)),
+                                             _mm_or_si128(expand_bits((std::uint16_t)(back_wall >> k), WALL_BACK << 4), expand_bits((std::uint16_t)(front_wall >> k), WALL_FRONT << 4)));
+                walls = _mm_or_si128(walls, expand_bits((std::uint16_t)(wall >> k), ALL_WALLS << 4));
+                __m128i *cells = (__m128i*)(row + first + k);
+                _mm_storeu_si128(cells, _mm_or_si128(_mm_and_si128(_mm_loadu_si128(cells), low), walls));
+            }
+#endif
+            for (; k < count; ++k) {
+                int walls = (int)((left >> k) & 1) | (int)((right >> k) & 1) << 1 | (int)((back_wall >> k) & 1) << 2 | (int)((front_wall >> k) & 1) << 3;
+                walls |= -(int)((wall >> k) & 1) & ALL_WALLS;   // Wall rooms are closed on every side
+                row[first + k] = (std::uint8_t)((row[first + k] & 0x0F) | walls << 4);
+            }
+        }
+    }
+}
+
+
+// Defining the walls of every room: a side is closed when the neighbour is a wall (type 1) or outside the layer.
+// Wall rooms are closed on every side. Rows are processed on the pool threads when one is given.
+// The rows are read and written in place, tiled grids are stored row-major meanwhile (paged grids are loaded whole)
+inline void derive_walls(maze_grid &grid, ThreadPool *pool = nullptr) {
+    if (grid.cells.paged())
+        grid.cells.resize(grid.cells.size());
+
+    int tile_shift = grid.tile_shift;
+    set_grid_layout(grid, LAYOUT_ROW_MAJOR);
+
+    int rows = grid.layers * grid.height;
+    int words = (grid.width + 63) / 64;
+    if (rows == 0 || words == 0) {
+        set_grid_layout(grid, tile_shift);
+        return;
+    }
+
+    // The wall masks are built first, so no row writes a byte that another row reads
+    std::vector<std::uint64_t> masks((std::size_t)rows * words);
+    std::function<void(int, int)> build = [&](int begin, int end) {
+        for (int r = begin; r < end; ++r)
+            wall_row_mask(grid.cells.data() + (std::size_t)r * grid.width, grid.width, &masks[(std::size_t)r * words]);
+    };
+    std::function<void(int, int)> derive = [&](int begin, int end) { derive_wall_rows(grid, masks, words, begin, end); };
+
+    const int chunk = 64;
+    if (pool) {
+        pool->parallel_for(rows, chunk, build);
+        pool->parallel_for(rows, chunk, derive);
+    }
+    else {
+        build(0, rows);
+        derive(0, rows);
+    }
+    set_grid_layout(grid, tile_shift);
+}
+#endif
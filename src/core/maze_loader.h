@@ -0,0 +1,17 @@
+#ifndef MAZE_LOADER_H
+#define MAZE_LOADER_H
+
+#include "maze_model.h"
+#include "maze_binary.h"
+#include "maze_text_parser.h"
+
+
+// Loading a maze file, the format (binary or text) is picked from the file contents.
+// Text files are parsed (and walls derived) on the pool threads when one is given.
+// Binary mazes larger than memory_budget (when set) are paged in chunks instead of mapped whole
+inline bool load_maze(maze_model &maze, const char *file_name, ThreadPool *pool = nullptr, std::size_t memory_budget = 0) {
+    if (is_maze_binary(file_name))
+        return load_maze_binary(maze, file_name, pool, memory_budget);
+    return load_maze_text_parallel(maze, file_name, pool);
+}
+#endif
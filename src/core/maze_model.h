@@ -0,0 +1,220 @@
+#ifndef MAZE_MODEL_H
+#define MAZE_MODEL_H
+
+#include <fstream>
+#include <sstream>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+#include "maze_grid.h"
+
+
+// Maze model shared by the game, bots, tests and benchmarks. No GL or GLFW in here.
+
+typedef struct maze_model {
+    maze_grid grid;                                 // Room types and walls of every layer
+    std::pair<int, int> initial_element_position;   // (column, row) of the start room, on layer 0
+    int total_collectables;
+    std::vector<std::uint64_t> collectable_cells;   // Grid index of every collectable, in increasing order
+    std::vector<std::uint64_t> picked;              // Bitset over the collectable ids: items taken since the maze was loaded
+}maze_model;
+
+
+// Finding the collectables (type 4) of the grid, none of them picked. The cells are only read (a write access
+// would mark every chunk of a paged grid as changed)
+inline void index_collectables(maze_model &maze) {
+    const CellBuffer &cells = maze.grid.cells;
+    maze.collectable_cells.clear();
+    for (std::size_t i = 0; i < cells.size(); ++i)
+        if (cell_type_of(cells[i]) == 4)
+            maze.collectable_cells.push_back(i);
+    maze.total_collectables = (int)maze.collectable_cells.size();
+    maze.picked.assign((maze.collectable_cells.size() + 63) / 64, 0);
+}
+
+
+// Id (position in collectable_cells) of the collectable at a grid index, -1 when there is none
+inline int collectable_id(const maze_model &maze, std::size_t index) {
+    std::vector<std::uint64_t>::const_iterator found = std::lower_bound(maze.collectable_cells.begin(), maze.collectable_cells.end(), (std::uint64_t)index);
+    if (found == maze.collectable_cells.end() || *found != index)
+        return -1;
+    return (int)(found - maze.collectable_cells.begin());
+}
+
+
+// Picking the collectable of a grid index: the room becomes empty and the item is marked in the picked bitset
+inline void pick_collectable(maze_model &maze, std::size_t index) {
+    int id = collectable_id(maze, index);
+    if (id < 0)
+        return;
+    maze.picked[id >> 6] |= (std::uint64_t)1 << (id & 63);
+    std::uint8_t &cell = maze.grid.cells[index];
+    cell = (std::uint8_t)(cell & 0xF0);
+}
+
+
+// Putting back the items whose picked bit differs from the target bitset (all of them when target is null).
+// Only the changed rooms are touched, the cost depends on the number of items, not on the maze size
+inline void restore_collectables(maze_model &maze, const std::vector<std::uint64_t> *target = nullptr) {
+    for (std::size_t w = 0; w < maze.picked.size(); ++w) {
+        std::uint64_t wanted = target ? (*target)[w] : 0;
+        std::uint64_t changed = maze.picked[w] ^ wanted;
+        while (changed) {
+#if defined(__GNUC__)
+            int bit = __builtin_ctzll(changed);
+#else
+            int bit = 0;
+            while (!((changed >> bit) & 1))
+                ++bit;
+#endif
+            changed &= changed - 1;
+            std::uint8_t &cell = maze.grid.cells[maze.collectable_cells[w * 64 + bit]];
+            cell = (std::uint8_t)((cell & 0xF0) | ((wanted >> bit) & 1 ? 0 : 4));
+        }
+        maze.picked[w] = wanted;
+    }
+}
+
+
+// Storing the maze grid in another layout (grid_layouts), the collectable index follows (picked items are put back)
+inline void set_maze_layout(maze_model &maze, int tile_shift) {
+    restore_collectables(maze);
+    set_grid_layout(maze.grid, tile_shift);
+    index_collectables(maze);
+}
+
+
+// Reading the room types of one text row into a grid row (missing rooms are walls, extra ones are ignored).
+// Tokens are separated by spaces: a number is a room type, anything else (x) is the start room
+inline void parse_row(const std::string &line, std::uint8_t *row, int width, int &start_column) {
+    const char *c = line.c_str();
+    int column = 0;
+    while (*c && column < width) {
+        while (*c == ' ' || *c == '\t' || *c == '\r')
+            ++c;
+        if (!*c)
+            break;
+        const char *token = c;
+        while (*c && *c != ' ' && *c != '\t' && *c != '\r')
+            ++c;
+
+        int type = -1;
+        bool negative = *token == '-';
+        const char *digit = token + (negative ? 1 : 0);
+        if (digit < c && *digit >= '0' && *digit <= '9') {
+            type = 0;
+            for (; digit < c && *digit >= '0' && *digit <= '9'; ++digit)
+                type = type * 10 + (*digit - '0');
+            type = negative ? -type : type;
+        }
+        if (type == -1 && start_column < 0)
+            start_column = column;
+        row[column] = (std::uint8_t)((ALL_WALLS << 4) | (type & 0x0F));
+        ++column;
+    }
+    for (; column < width; ++column)
+        row[column] = (std::uint8_t)((ALL_WALLS << 4) | 1);
+}
+
+
+// Counting the tokens of a line
+inline int count_tokens(const std::string &line) {
+    int tokens = 0;
+    bool in_token = false;
+    for (std::size_t i = 0; i < line.size(); ++i) {
+        bool space = line[i] == ' ' || line[i] == '\t' || line[i] == '\r';
+        if (!space && !in_token)
+            ++tokens;
+        in_token = !space;
+    }
+    return tokens;
+}
+
+
+// Loading the maze from a text file, in a single streaming pass (memory is the size of the grid).
+// Dimensions come from an optional first line "maze <width> <height> <layers>". Without it, the width is
+// the number of rooms of the first row, and the height is the number of rows before the first blank line
+// (layers separated by blank lines) or, if there is none, the width (square layers)
+inline bool load_maze_text(maze_model &maze, const char *file_name) {
+    std::ifstream file(file_name);
+    if (!file)
+        return false;
+
+    // Header or first row
+    std::string line;
+    while (getline(file, line) && count_tokens(line) == 0);
+    int width = 0, height = 0, layers = 0;
+    bool pending_row = true;
+    if (line.compare(0, 4, "maze") == 0) {
+        std::stringstream header(line.substr(4));
+        if (!(header >> width >> height >> layers) || width <= 0 || height <= 0 || layers <= 0)
+            return false;
+        pending_row = false;
+    }
+    else
+        width = count_tokens(line);
+    if (width == 0)
+        return false;
+
+    // Rows are appended as they are read: the grid is row-major with layers one after the other.
+    // The file size gives a close estimate of the room count, so the storage is allocated once
+    maze.grid.cells.clear();
+    if (layers > 0)
+        maze.grid.cells.reserve((std::size_t)width * height * layers);
+    else {
+        std::streampos here = file.tellg();
+        file.seekg(0, std::ios::end);
+        maze.grid.cells.reserve((std::size_t)file.tellg() / 2 + width);
+        file.seekg(here);
+    }
+
+    std::size_t rows = 0;
+    std::size_t start_row = 0;
+    int start_column = -1;
+    while (pending_row || getline(file, line)) {
+        pending_row = false;
+        if (count_tokens(line) == 0) {
+            // A blank line closes a layer, the first one gives the layer height
+            if (height == 0 && rows > 0)
+                height = (int)rows;
+            continue;
+        }
+        if (layers > 0 && rows == (std::size_t)height * layers)
+            break;
+        maze.grid.cells.resize((rows + 1) * width);
+        int column = -1;
+        parse_row(line, &maze.grid.cells[rows * width], width, column);
+        if (column >= 0 && start_column < 0) {
+            start_column = column;
+            start_row = rows;
+        }
+        ++rows;
+    }
+    if (height == 0)
+        height = width;
+    // Without a header every layer is complete, a short last layer is rejected
+    if (layers == 0) {
+        if (rows % height != 0)
+            return false;
+        layers = (int)(rows / height);
+    }
+    if (layers == 0 || rows < (std::size_t)height * layers)
+        return false;
+
+    set_grid_size(maze.grid, width, height, layers);
+    maze.grid.cells.resize((std::size_t)width * height * layers);
+
+    // Start room (on the first layer) and collectables
+    maze.initial_element_position = std::make_pair(0, 0);
+    if (start_column >= 0 && start_row < (std::size_t)height)
+        maze.initial_element_position = std::make_pair(start_column, (int)start_row);
+    index_collectables(maze);
+
+    // Defining the walls
+    derive_walls(maze.grid);
+    return true;
+}
+#endif
@@ -0,0 +1,279 @@
+#ifndef MAZE_TEXT_PARSER_H
+#define MAZE_TEXT_PARSER_H
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../dependencies/UTILS/mapped_file.h"
+#include "../dependencies/UTILS/thread_pool.h"
+#include "maze_model.h"
+
+
+// Parallel text maze parser: the file is mapped, split in line-aligned chunks and every chunk is parsed on
+// its own thread, straight into the grid. Same format and dimension rules as load_maze_text().
+// Whitespace and digits are classified 64 bytes at a time (SSE2 when available).
+
+const std::size_t PARSER_CHUNK_SIZE = 1 << 22;
+
+
+inline bool is_blank_char(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+
+// Bit i of non_blank / digits is set when p[i] is not whitespace / is a digit (64 bytes)
+inline void classify_block(const char *p, std::uint64_t &non_blank, std::uint64_t &digits) {
+#ifdef MAZE_SSE2
+    const __m128i space = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t'), carriage = _mm_set1_epi8('\r');
+    const __m128i zero = _mm_set1_epi8('0'), nine = _mm_set1_epi8(9);
+    non_blank = 0;
+    digits = 0;
+    for (int k = 0; k < 4; ++k) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(p + 16 * k));
+        __m128i blank = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, space), _mm_cmpeq_epi8(bytes, tab)), _mm_cmpeq_epi8(bytes, carriage));
+        __m128i value = _mm_sub_epi8(bytes, zero);
+        __m128i digit = _mm_cmpeq_epi8(_mm_min_epu8(value, nine), value);   // (c - '0') <= 9, unsigned
+        non_blank |= (std::uint64_t)(~_mm_movemask_epi8(blank) & 0xFFFF) << (16 * k);
+        digits |= (std::uint64_t)(_mm_movemask_epi8(digit) & 0xFFFF) << (16 * k);
+    }
+#else
+    non_blank = 0;
+    digits = 0;
+    for (int i = 0; i < 64; ++i) {
+        non_blank |= (std::uint64_t)!is_blank_char(p[i]) << i;
+        digits |= (std::uint64_t)(p[i] >= '0' && p[i] <= '9') << i;
+    }
+#endif
+}
+
+
+// Type of the token starting at p (a number, anything else is the start room -1)
+inline int parse_token(const char *p, const char *end) {
+    bool negative = *p == '-';
+    const char *digit = p + (negative ? 1 : 0);
+    if (digit >= end || *digit < '0' || *digit > '9')
+        return -1;
+    int type = 0;
+    for (; digit < end && *digit >= '0' && *digit <= '9'; ++digit)
+        type = type * 10 + (*digit - '0');
+    return negative ? -type : type;
+}
+
+
+// Parsing one line [begin, end) into a grid row. Returns the column of the start room, or -1
+inline int parse_row_fast(const char *begin, const char *end, std::uint8_t *row, int width) {
+    int column = 0, start_column = -1;
+    std::uint64_t carry = 0;   // Whether the last byte of the previous block was part of a token
+    char tail[64];
+
+    for (const char *block = begin; block < end && column < width; block += 64) {
+        // The last partial block is copied into a space-padded buffer (never read past the line)
+        const char *p = block;
+        std::size_t length = (std::size_t)(end - block);
+        if (length < 64) {
+            std::memset(tail, ' ', sizeof(tail));
+            std::memcpy(tail, block, length);
+            p = tail;
+        }
+        std::uint64_t non_blank, digits;
+        classify_block(p, non_blank, digits);
+
+        std::uint64_t starts = non_blank & ~((non_blank << 1) | carry);
+        carry = non_blank >> 63;
+        while (starts && column < width) {
+#if defined(__GNUC__)
+            int i = __builtin_ctzll(starts);
+#else
+            int i = 0;
+            while (!((starts >> i) & 1))
+                ++i;
+#endif
+            starts &= starts - 1;
+
+            // Single digit tokens (the common case) are decoded from the masks, anything else by hand
+            int type;
+            bool single = i < 63 ? !((non_blank >> (i + 1)) & 1) : (block + 64 >= end || is_blank_char(block[64]));
+            if (((digits >> i) & 1) && single)
+                type = p[i] - '0';
+            else
+                type = parse_token(block + i, end);
+
+            if (type == -1 && start_column < 0)
+                start_column = column;
+            row[column++] = (std::uint8_t)((ALL_WALLS << 4) | (type & 0x0F));
+        }
+    }
+    for (; column < width; ++column)
+        row[column] = (std::uint8_t)((ALL_WALLS << 4) | 1);
+    return start_column;
+}
+
+
+inline bool blank_line(const char *begin, const char *end) {
+    for (; begin < end; ++begin)
+        if (!is_blank_char(*begin))
+            return false;
+    return true;
+}
+
+
+// What the first pass learns about a chunk
+typedef struct parser_chunk {
+    const char *begin;
+    const char *end;
+    std::size_t rows;               // Non-blank lines
+    std::size_t rows_before_blank;  // Non-blank lines before the first blank line
+    bool has_blank;
+    std::size_t first_row;          // Grid row of the first line (prefix sum of rows)
+    std::size_t start_row;          // First start room found (row, column), start_column = -1 when none
+    int start_column;
+}parser_chunk;
+
+
+// Loading a text maze with every thread of the pool (pool may be null: chunks are then parsed in turn)
+inline bool load_maze_text_parallel(maze_model &maze, const char *file_name, ThreadPool *pool) {
+    std::shared_ptr<MappedFile> mapping = std::make_shared<MappedFile>();
+    if (!mapping->open(file_name))
+        return false;
+    const char *data = (const char*)mapping->data();
+    const char *file_end = data + mapping->size();
+
+    // Header or first row
+    const char *cursor = data;
+    const char *line_end = cursor;
+    while (cursor < file_end) {
+        line_end = (const char*)std::memchr(cursor, '\n', file_end - cursor);
+        if (!line_end)
+            line_end = file_end;
+        if (!blank_line(cursor, line_end))
+            break;
+        cursor = line_end + 1;
+    }
+    if (cursor >= file_end)
+        return false;
+    std::string first_line(cursor, line_end);
+    int width = 0, height = 0, layers = 0;
+    if (first_line.compare(0, 4, "maze") == 0) {
+        std::stringstream header(first_line.substr(4));
+        if (!(header >> width >> height >> layers) || width <= 0 || height <= 0 || layers <= 0)
+            return false;
+        cursor = line_end < file_end ? line_end + 1 : file_end;
+    }
+    else
+        width = count_tokens(first_line);
+
+    // Line-aligned chunks
+    std::vector<parser_chunk> chunks;
+    while (cursor < file_end) {
+        parser_chunk chunk;
+        chunk.begin = cursor;
+        const char *end = cursor + PARSER_CHUNK_SIZE < file_end ? cursor + PARSER_CHUNK_SIZE : file_end;
+        if (end < file_end) {
+            const char *newline = (const char*)std::memchr(end, '\n', file_end - end);
+            end = newline ? newline + 1 : file_end;
+        }
+        chunk.end = end;
+        chunks.push_back(chunk);
+        cursor = end;
+    }
+    int count = (int)chunks.size();
+    auto for_each_chunk = [&](const std::function<void(int, int)> &task) {
+        if (pool)
+            pool->parallel_for(count, 1, task);
+        else
+            task(0, count);
+    };
+
+    // First pass: rows and blank lines of every chunk
+    for_each_chunk([&](int first, int last) {
+        for (int c = first; c < last; ++c) {
+            parser_chunk &chunk = chunks[c];
+            chunk.rows = 0;
+            chunk.has_blank = false;
+            chunk.rows_before_blank = 0;
+            for (const char *line = chunk.begin; line < chunk.end;) {
+                const char *end = (const char*)std::memchr(line, '\n', chunk.end - line);
+                if (!end)
+                    end = chunk.end;
+                if (blank_line(line, end)) {
+                    if (!chunk.has_blank)
+                        chunk.rows_before_blank = chunk.rows;
+                    chunk.has_blank = true;
+                }
+                else
+                    ++chunk.rows;
+                line = end + 1;
+            }
+        }
+    });
+
+    // Grid rows of every chunk, and the height from the first blank line that follows a row
+    std::size_t rows = 0;
+    for (int c = 0; c < count; ++c) {
+        chunks[c].first_row = rows;
+        if (height == 0 && chunks[c].has_blank && rows + chunks[c].rows_before_blank > 0)
+            height = (int)(rows + chunks[c].rows_before_blank);
+        rows += chunks[c].rows;
+    }
+    if (width == 0)
+        return false;
+    if (height == 0)
+        height = width;
+    // Without a header every layer is complete, a short last layer is rejected
+    if (layers == 0) {
+        if (rows % height != 0)
+            return false;
+        layers = (int)(rows / height);
+    }
+    if (layers == 0 || rows < (std::size_t)height * layers)
+        return false;
+    std::size_t grid_rows = (std::size_t)height * layers;
+    maze.grid.cells.clear();
+    maze.grid.cells.resize(grid_rows * width);
+    set_grid_size(maze.grid, width, height, layers);
+    std::uint8_t *cells = maze.grid.cells.data();
+
+    // Second pass: rooms of every chunk, straight into the grid
+    for_each_chunk([&](int first, int last) {
+        for (int c = first; c < last; ++c) {
+            parser_chunk &chunk = chunks[c];
+            chunk.start_column = -1;
+            std::size_t row = chunk.first_row;
+            for (const char *line = chunk.begin; line < chunk.end && row < grid_rows;) {
+                const char *end = (const char*)std::memchr(line, '\n', chunk.end - line);
+                if (!end)
+                    end = chunk.end;
+                if (!blank_line(line, end)) {
+                    int column = parse_row_fast(line, end, cells + row * width, width);
+                    if (column >= 0 && chunk.start_column < 0) {
+                        chunk.start_column = column;
+                        chunk.start_row = row;
+                    }
+                    ++row;
+                }
+                line = end + 1;
+            }
+        }
+    });
+
+    // Start room (on the first layer) and collectables
+    maze.initial_element_position = std::make_pair(0, 0);
+    for (int c = 0; c < count; ++c) {
+        if (chunks[c].start_column >= 0) {
+            if (chunks[c].start_row < (std::size_t)height)
+                maze.initial_element_position = std::make_pair(chunks[c].start_column, (int)chunks[c].start_row);
+            break;
+        }
+    }
+    index_collectables(maze);
+
+    // Defining the walls
+    derive_walls(maze.grid, pool);
+    return true;
+}
+#endif
@@ -0,0 +1,181 @@
+#ifndef PAGED_CELLS_H
+#define PAGED_CELLS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "run_length_cells.h"
+
+
+// Cells of a row-major grid that stay in a (memory-mapped) file, or run-length encoded in memory, and are
+// loaded on demand, in square chunks of CHUNK_SIDE x CHUNK_SIDE rooms of one layer. Resident chunks are
+// limited by a memory budget, the least recently used one is evicted first. Changed chunks are never dropped:
+// they count against the budget, clean chunks are evicted before them and they are only kept aside (out of the
+// slots) when every slot holds a changed chunk, so the memory used is the budget or the changed chunks if larger.
+// Not thread-safe, reads update the cache.
+
+const int CHUNK_SHIFT = 8;
+const int CHUNK_SIDE = 1 << CHUNK_SHIFT;
+const std::size_t CHUNK_BYTES = (std::size_t)CHUNK_SIDE * CHUNK_SIDE;
+
+class PagedCells {
+    private:
+        typedef struct chunk_slot {
+            std::uint64_t id;
+            std::uint64_t last_used;
+            bool dirty;
+            std::vector<std::uint8_t> cells;    // CHUNK_SIDE rows of CHUNK_SIDE rooms
+        }chunk_slot;
+
+        std::shared_ptr<void> mapping;          // Keeps the plane alive
+        const std::uint8_t *plane;
+        std::shared_ptr<const RunLengthRows> encoded;   // Source of the chunks when there is no plane
+        int width;
+        int height;
+        int layers;
+        int chunk_columns;
+        int chunk_rows;
+        std::size_t max_chunks;
+
+        std::vector<chunk_slot> slots;
+        std::unordered_map<std::uint64_t, int> resident;                    // Chunk id -> slot
+        std::unordered_map<std::uint64_t, std::vector<std::uint8_t> > changed;  // Evicted dirty chunks
+        std::uint64_t clock;
+        std::uint64_t last_id;                  // Last chunk used, skips the lookup while a walk stays inside it
+        int last_slot;
+        std::uint64_t chunk_loads;
+
+        std::uint64_t chunk_id(int layer, int chunk_column, int chunk_row) const {
+            return ((std::uint64_t)layer * chunk_rows + chunk_row) * chunk_columns + chunk_column;
+        }
+
+        // Copying a chunk from the plane or the encoded rows (or from the changed chunks) into a slot
+        void fill(chunk_slot &slot, std::uint64_t id) {
+            slot.id = id;
+            slot.dirty = false;
+            std::unordered_map<std::uint64_t, std::vector<std::uint8_t> >::iterator kept = changed.find(id);
+            if (kept != changed.end()) {
+                slot.cells.swap(kept->second);
+                slot.dirty = true;
+                changed.erase(kept);
+                return;
+            }
+            slot.cells.assign(CHUNK_BYTES, (std::uint8_t)0xF1);
+            int layer = (int)(id / ((std::uint64_t)chunk_rows * chunk_columns));
+            int chunk_row = (int)(id / chunk_columns % chunk_rows);
+            int chunk_column = (int)(id % chunk_columns);
+            int first_column = chunk_column << CHUNK_SHIFT, first_row = chunk_row << CHUNK_SHIFT;
+            int columns = std::min(CHUNK_SIDE, width - first_column), rows = std::min(CHUNK_SIDE, height - first_row);
+            for (int r = 0; r < rows; ++r) {
+                std::size_t row = (std::size_t)layer * height + first_row + r;
+                if (encoded)
+                    encoded->decode(row, first_column, columns, &slot.cells[(std::size_t)r << CHUNK_SHIFT]);
+                else
+                    std::memcpy(&slot.cells[(std::size_t)r << CHUNK_SHIFT], plane + row * width + first_column, columns);
+            }
+            ++chunk_loads;
+        }
+
+        // Slot holding a chunk, loading it (and evicting the least recently used one) when needed
+        int slot_of(std::uint64_t id) {
+            if (id == last_id)
+                return last_slot;
+            std::unordered_map<std::uint64_t, int>::iterator found = resident.find(id);
+            int slot;
+            if (found != resident.end())
+                slot = found->second;
+            else {
+                if (slots.empty() || slots.size() + changed.size() < max_chunks) {
+                    slots.push_back(chunk_slot());
+                    slot = (int)slots.size() - 1;
+                }
+                else {
+                    // Least recently used clean chunk, a changed one only when there is none
+                    slot = 0;
+                    for (int s = 1; s < (int)slots.size(); ++s)
+                        if (slots[s].dirty != slots[slot].dirty ? !slots[s].dirty : slots[s].last_used < slots[slot].last_used)
+                            slot = s;
+                    resident.erase(slots[slot].id);
+                    if (slots[slot].dirty)
+                        changed[slots[slot].id].swap(slots[slot].cells);
+                }
+                fill(slots[slot], id);
+                resident[id] = slot;
+            }
+            slots[slot].last_used = ++clock;
+            last_id = id;
+            last_slot = slot;
+            return slot;
+        }
+    public:
+        // plane: layers * height * width cells (row-major) inside a mapping kept alive by keep_alive
+        PagedCells(std::shared_ptr<void> keep_alive, const std::uint8_t *plane, int width, int height, int layers, std::size_t memory_budget)
+            : mapping(keep_alive), plane(plane), width(width), height(height), layers(layers), clock(0), last_id(~(std::uint64_t)0), last_slot(-1), chunk_loads(0) {
+            chunk_columns = (width + CHUNK_SIDE - 1) >> CHUNK_SHIFT;
+            chunk_rows = (height + CHUNK_SIDE - 1) >> CHUNK_SHIFT;
+            max_chunks = std::max<std::size_t>(memory_budget / CHUNK_BYTES, 16);
+        }
+        // layers * height run-length encoded rows of width cells
+        PagedCells(std::shared_ptr<const RunLengthRows> rows, int width, int height, int layers, std::size_t memory_budget)
+            : PagedCells(nullptr, nullptr, width, height, layers, memory_budget) {
+            encoded = rows;
+        }
+
+        // Cell at a row-major grid index, marked as changed when write is set.
+        // The reference is valid until the next access
+        std::uint8_t& at(std::size_t index, bool write) {
+            std::size_t layer_size = (std::size_t)width * height;
+            int layer = (int)(index / layer_size);
+            std::size_t offset = index - (std::size_t)layer * layer_size;
+            int row = (int)(offset / width), column = (int)(offset - (std::size_t)row * width);
+            chunk_slot &slot = slots[slot_of(chunk_id(layer, column >> CHUNK_SHIFT, row >> CHUNK_SHIFT))];
+            slot.dirty |= write;
+            return slot.cells[((std::size_t)(row & (CHUNK_SIDE - 1)) << CHUNK_SHIFT) + (column & (CHUNK_SIDE - 1))];
+        }
+
+        // Copying count cells of a grid row (layer * height + row), from first_column on, chunk by chunk
+        void read_row(std::size_t row, int first_column, int count, std::uint8_t *out) {
+            int layer = (int)(row / height), layer_row = (int)(row % height);
+            for (int column = first_column; column < first_column + count;) {
+                int end = std::min(((column >> CHUNK_SHIFT) + 1) << CHUNK_SHIFT, first_column + count);
+                const chunk_slot &slot = slots[slot_of(chunk_id(layer, column >> CHUNK_SHIFT, layer_row >> CHUNK_SHIFT))];
+                std::memcpy(out + (column - first_column), &slot.cells[((std::size_t)(layer_row & (CHUNK_SIDE - 1)) << CHUNK_SHIFT) + (column & (CHUNK_SIDE - 1))], end - column);
+                column = end;
+            }
+        }
+
+        // Loading the chunks around a room and the ones ahead of it (direction_x, direction_z), up to reach chunks away
+        void prefetch(int layer, int column, int row, float direction_x, float direction_z, int reach) {
+            if (layer < 0 || layer >= layers)
+                return;
+            int chunk_column = column >> CHUNK_SHIFT, chunk_row = row >> CHUNK_SHIFT;
+            int step_column = direction_x > 0.38f ? 1 : (direction_x < -0.38f ? -1 : 0);
+            int step_row = direction_z > 0.38f ? 1 : (direction_z < -0.38f ? -1 : 0);
+            for (int k = 0; k <= reach; ++k) {
+                for (int side = -1; side <= 1; ++side) {
+                    int c = chunk_column + k * step_column + (step_row != 0 ? side : 0);
+                    int r = chunk_row + k * step_row + (step_row == 0 ? side : 0);
+                    if (c >= 0 && c < chunk_columns && r >= 0 && r < chunk_rows)
+                        slot_of(chunk_id(layer, c, r));
+                }
+                if (step_column == 0 && step_row == 0)
+                    break;
+            }
+        }
+
+        // Bytes of the chunks in memory, the changed ones kept aside included
+        std::size_t resident_bytes() const {
+            return (slots.size() + changed.size()) * CHUNK_BYTES;
+        }
+        const RunLengthRows* run_lengths() const {
+            return encoded.get();
+        }
+        std::uint64_t loads() const {
+            return chunk_loads;
+        }
+};
+#endif
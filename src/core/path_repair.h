@@ -0,0 +1,244 @@
+#ifndef PATH_REPAIR_H
+#define PATH_REPAIR_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "pathfinding.h"
+#include "maze_edit.h"
+
+
+// Incremental route planning (D* Lite) for rooms that change while an agent follows a route: the search runs
+// backwards from the goal and keeps, for every room it reached, its distance to the goal (g) and the best distance
+// through its next rooms (rhs). After edit_room() only the rooms whose moves changed are looked at again and the
+// search goes on from them until the agent's room is settled, instead of starting over. The moves are those of
+// room_neighbours(): open sides, and the elevators as the player takes them (up from type 2, down from type 3,
+// into a walkable room). The agent's room may change between repairs (move_repair_start), keys then stay lower
+// bounds through the km offset. The state is 8 bytes per room plus the heap.
+
+const std::uint32_t REPAIR_UNREACHED = 0xFFFFFFFFu;
+
+// Heap entry: key (first half in the high bits: min(g, rhs) + h + km, then min(g, rhs)) and the room id
+typedef struct repair_entry {
+    std::uint64_t key;
+    std::uint64_t room;
+}repair_entry;
+
+// Reusable planner state, sized for one maze
+typedef struct repair_planner {
+    std::size_t rooms;
+    std::uint64_t start;                // Agent's room
+    std::uint64_t goal;
+    std::uint64_t last_start;           // Agent's room at the previous repair
+    std::uint32_t km;                   // Heuristic offset gathered by the agent's moves
+    std::vector<std::uint32_t> g;       // Distances to the goal (REPAIR_UNREACHED when unknown)
+    std::vector<std::uint32_t> rhs;
+    std::vector<repair_entry> open;     // Binary heap, stale entries are skipped when popped
+    long long expanded;                 // Rooms settled by the last plan or repair
+}repair_planner;
+
+
+// Allocating the planner state of a maze (done once, plan_repair_route resets it)
+inline void prepare_repair(repair_planner &planner, const maze_model &maze) {
+    planner.rooms = (std::size_t)maze.grid.width * maze.grid.height * maze.grid.layers;
+    planner.g.assign(planner.rooms, REPAIR_UNREACHED);
+    planner.rhs.assign(planner.rooms, REPAIR_UNREACHED);
+    planner.open.clear();
+    planner.start = planner.goal = planner.last_start = 0;
+    planner.km = 0;
+    planner.expanded = 0;
+}
+
+
+// Rooms with a move into a room: fills ids, returns how many. Sides are open both ways, elevators only lead up
+// from a type 2 room and down from a type 3 room
+inline int room_predecessors(const maze_grid &grid, std::uint64_t id, std::uint64_t *ids) {
+    std::uint8_t byte = room_byte(grid, id);
+    int walls = byte >> 4, count = 0;
+    std::uint64_t layer_rooms = (std::uint64_t)grid.width * grid.height;
+
+    if (!(walls & WALL_LEFT)) ids[count++] = id - 1;
+    if (!(walls & WALL_RIGHT)) ids[count++] = id + 1;
+    if (!(walls & WALL_BACK)) ids[count++] = id - grid.width;
+    if (!(walls & WALL_FRONT)) ids[count++] = id + grid.width;
+    if (cell_type_of(byte) == 1)
+        return count;
+    if (id >= layer_rooms && cell_type_of(room_byte(grid, id - layer_rooms)) == 2)
+        ids[count++] = id - layer_rooms;
+    if (id + layer_rooms < layer_rooms * grid.layers && cell_type_of(room_byte(grid, id + layer_rooms)) == 3)
+        ids[count++] = id + layer_rooms;
+    return count;
+}
+
+
+inline bool repair_after(const repair_entry &a, const repair_entry &b) {
+    return a.key > b.key;
+}
+
+inline std::uint64_t repair_key(const repair_planner &planner, const maze_grid &grid, std::uint64_t id) {
+    std::uint32_t best = std::min(planner.g[id], planner.rhs[id]);
+    if (best == REPAIR_UNREACHED)
+        return ~(std::uint64_t)0;
+    std::uint64_t first = (std::uint64_t)best + path_heuristic(room_cell(grid, planner.start), room_cell(grid, id)) + planner.km;
+    return first << 32 | best;
+}
+
+// Best distance through the next rooms of a room
+inline std::uint32_t repair_rhs(const repair_planner &planner, const maze_grid &grid, std::uint64_t id) {
+    if (id == planner.goal)
+        return 0;
+    std::uint64_t ids[6];
+    std::uint8_t moves[6];
+    int count = room_neighbours(grid, id, ids, moves);
+    std::uint32_t best = REPAIR_UNREACHED;
+    for (int n = 0; n < count; ++n)
+        if (planner.g[ids[n]] != REPAIR_UNREACHED)
+            best = std::min(best, planner.g[ids[n]] + 1);
+    return best;
+}
+
+// Queuing a room whose g and rhs disagree
+inline void queue_inconsistent(repair_planner &planner, const maze_grid &grid, std::uint64_t id) {
+    if (planner.g[id] == planner.rhs[id])
+        return;
+    repair_entry entry = {repair_key(planner, grid, id), id};
+    planner.open.push_back(entry);
+    std::push_heap(planner.open.begin(), planner.open.end(), repair_after);
+}
+
+
+// Settling rooms in key order until the agent's room is settled and no queued room can shorten its route
+inline void settle_rooms(repair_planner &planner, const maze_grid &grid) {
+    std::vector<repair_entry> &open = planner.open;
+    std::uint64_t ids[6];
+    planner.expanded = 0;
+    while (!open.empty()) {
+        repair_entry top = open.front();
+        if (top.key >= repair_key(planner, grid, planner.start) && planner.g[planner.start] == planner.rhs[planner.start])
+            break;
+        std::pop_heap(open.begin(), open.end(), repair_after);
+        open.pop_back();
+        std::uint64_t id = top.room;
+        if (planner.g[id] == planner.rhs[id])
+            continue;
+        std::uint64_t key = repair_key(planner, grid, id);
+        if (top.key < key) {
+            // Queued before the agent moved (or before rhs went up), queued again with its key
+            repair_entry entry = {key, id};
+            open.push_back(entry);
+            std::push_heap(open.begin(), open.end(), repair_after);
+            continue;
+        }
+        ++planner.expanded;
+        int count = room_predecessors(grid, id, ids);
+        if (planner.g[id] > planner.rhs[id]) {
+            // Shorter than known: the rooms leading here may get shorter too
+            planner.g[id] = planner.rhs[id];
+            for (int n = 0; n < count; ++n) {
+                if (ids[n] == planner.goal || planner.g[id] + 1 >= planner.rhs[ids[n]])
+                    continue;
+                planner.rhs[ids[n]] = planner.g[id] + 1;
+                queue_inconsistent(planner, grid, ids[n]);
+            }
+        }
+        else {
+            // Longer than known: the rooms whose best route went through here look again
+            std::uint32_t previous = planner.g[id];
+            planner.g[id] = REPAIR_UNREACHED;
+            for (int n = 0; n < count; ++n) {
+                if (ids[n] != planner.goal && planner.rhs[ids[n]] == previous + 1)
+                    planner.rhs[ids[n]] = repair_rhs(planner, grid, ids[n]);
+                queue_inconsistent(planner, grid, ids[n]);
+            }
+            queue_inconsistent(planner, grid, id);
+        }
+    }
+}
+
+
+// Planning from scratch between two rooms: returns the distance (-1 when unreachable). The planner keeps the
+// search for the repairs that follow
+inline long long plan_repair_route(repair_planner &planner, const maze_model &maze, const maze_cell &from, const maze_cell &to) {
+    const maze_grid &grid = maze.grid;
+    std::fill(planner.g.begin(), planner.g.end(), REPAIR_UNREACHED);
+    std::fill(planner.rhs.begin(), planner.rhs.end(), REPAIR_UNREACHED);
+    planner.open.clear();
+    planner.km = 0;
+    planner.expanded = 0;
+    if (!walkable(grid, from) || !walkable(grid, to))
+        return -1;
+    planner.start = planner.last_start = room_id(grid, from);
+    planner.goal = room_id(grid, to);
+    planner.rhs[planner.goal] = 0;
+    queue_inconsistent(planner, grid, planner.goal);
+    settle_rooms(planner, grid);
+    return planner.g[planner.start] == REPAIR_UNREACHED ? -1 : (long long)planner.g[planner.start];
+}
+
+
+// The agent moved (a move of the route or any other room, an elevator included): later repairs are keyed from there
+inline void move_repair_start(repair_planner &planner, const maze_model &maze, const maze_cell &cell) {
+    planner.start = room_id(maze.grid, cell);
+}
+
+
+// Repairing the route after rooms were edited (edit_room, already applied): the moves out of the edited rooms,
+// their neighbours and the rooms above and below changed, their rhs is found again and the search goes on.
+// Returns the distance from the agent's room (-1 when unreachable)
+inline long long repair_route(repair_planner &planner, const maze_model &maze, const room_edit *edits, std::size_t count) {
+    const maze_grid &grid = maze.grid;
+    std::uint64_t layer_rooms = (std::uint64_t)grid.width * grid.height;
+    planner.km += path_heuristic(room_cell(grid, planner.last_start), room_cell(grid, planner.start));
+    planner.last_start = planner.start;
+
+    const int columns[5] = {0, -1, 1, 0, 0};
+    const int rows[5] = {0, 0, 0, -1, 1};
+    for (std::size_t k = 0; k < count; ++k) {
+        const room_edit &edit = edits[k];
+        std::uint64_t touched[7];
+        int touched_count = 0;
+        for (int n = 0; n < 5; ++n)
+            if (inside_grid(grid, edit.layer, edit.column + columns[n], edit.row + rows[n]))
+                touched[touched_count++] = room_id(grid, {edit.layer, edit.column + columns[n], edit.row + rows[n]});
+        if (edit.layer > 0)
+            touched[touched_count++] = touched[0] - layer_rooms;
+        if (edit.layer + 1 < grid.layers)
+            touched[touched_count++] = touched[0] + layer_rooms;
+        for (int n = 0; n < touched_count; ++n) {
+            planner.rhs[touched[n]] = repair_rhs(planner, grid, touched[n]);
+            queue_inconsistent(planner, grid, touched[n]);
+        }
+    }
+    settle_rooms(planner, grid);
+    return planner.g[planner.start] == REPAIR_UNREACHED ? -1 : (long long)planner.g[planner.start];
+}
+
+
+// Rooms of the current route, from the agent's room to the goal (both included, empty when unreachable): each
+// step goes to the next room closest to the goal, as an agent would follow it
+inline long long repair_path(const repair_planner &planner, const maze_model &maze, std::vector<maze_cell> &path) {
+    const maze_grid &grid = maze.grid;
+    path.clear();
+    if (planner.g[planner.start] == REPAIR_UNREACHED)
+        return -1;
+    std::uint64_t ids[6];
+    std::uint8_t moves[6];
+    for (std::uint64_t id = planner.start;; ) {
+        path.push_back(room_cell(grid, id));
+        if (id == planner.goal)
+            break;
+        int count = room_neighbours(grid, id, ids, moves);
+        std::uint64_t next = id;
+        for (int n = 0; n < count; ++n)
+            if (planner.g[ids[n]] != REPAIR_UNREACHED && (next == id || planner.g[ids[n]] < planner.g[next]))
+                next = ids[n];
+        if (next == id) {
+            path.clear();
+            return -1;
+        }
+        id = next;
+    }
+    return (long long)path.size() - 1;
+}
+#endif
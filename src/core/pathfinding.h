@@ -0,0 +1,241 @@
+#ifndef PATHFINDING_H
+#define PATHFINDING_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include "maze_model.h"
+
+
+// Routes through the maze, across layers: a room leads to its open neighbours (cell_walls) and, for an
+// elevator, to the same room of the layer above (type 2) or below (type 3), as take_elevator() does.
+// Every move costs 1. Rooms are identified by their row-major id ((layer * height + row) * width + column),
+// whatever the grid layout. The search state is a visited bitset, one move byte per room and flat lists.
+
+typedef struct maze_cell {
+    int layer;
+    int column;
+    int row;
+}maze_cell;
+
+enum path_moves { MOVE_LEFT = 0, MOVE_RIGHT = 1, MOVE_BACK = 2, MOVE_FRONT = 3, MOVE_UP = 4, MOVE_DOWN = 5 };
+
+// A* heap entry: f = g + h, and the room id with the move that reached it (id << 3 | move)
+typedef struct open_entry {
+    std::uint32_t f;
+    std::uint32_t h;
+    std::uint64_t room;
+}open_entry;
+
+// Reusable search state, sized for one maze
+typedef struct path_search {
+    std::size_t rooms;
+    std::vector<std::uint64_t> visited;         // One bit per room id
+    std::unique_ptr<std::uint8_t[]> moves;      // Move that reached each visited room (not initialized)
+    std::vector<std::uint64_t> frontier;        // BFS levels
+    std::vector<std::uint64_t> next;
+    std::vector<open_entry> open;               // A* binary heap
+}path_search;
+
+
+inline std::uint64_t room_id(const maze_grid &grid, const maze_cell &cell) {
+    return ((std::uint64_t)cell.layer * grid.height + cell.row) * grid.width + cell.column;
+}
+
+inline maze_cell room_cell(const maze_grid &grid, std::uint64_t id) {
+    maze_cell cell;
+    std::uint64_t row_id = id / grid.width;
+    cell.column = (int)(id - row_id * grid.width);
+    cell.layer = (int)(row_id / grid.height);
+    cell.row = (int)(row_id - (std::uint64_t)cell.layer * grid.height);
+    return cell;
+}
+
+inline bool walkable(const maze_grid &grid, const maze_cell &cell) {
+    return inside_grid(grid, cell.layer, cell.column, cell.row) && cell_type(grid, cell.layer, cell.column, cell.row) != 1;
+}
+
+// Cell byte of a room id (row-major grids are indexed by the id itself)
+inline std::uint8_t room_byte(const maze_grid &grid, std::uint64_t id) {
+    if (grid.tile_shift == LAYOUT_ROW_MAJOR)
+        return grid.cells[id];
+    maze_cell cell = room_cell(grid, id);
+    return grid.cells[grid_index(grid, cell.layer, cell.column, cell.row)];
+}
+
+
+// Allocating the search state of a maze (done once, queries only clear the bitset)
+inline void prepare_search(path_search &search, const maze_model &maze) {
+    search.rooms = (std::size_t)maze.grid.width * maze.grid.height * maze.grid.layers;
+    search.visited.assign((search.rooms + 63) / 64, 0);
+    search.moves.reset(new std::uint8_t[search.rooms]);
+}
+
+inline bool test_and_visit(path_search &search, std::uint64_t id) {
+    std::uint64_t bit = (std::uint64_t)1 << (id & 63);
+    if (search.visited[id >> 6] & bit)
+        return false;
+    search.visited[id >> 6] |= bit;
+    return true;
+}
+
+
+// Rooms reachable in one move from a room: fills ids and moves, returns how many
+inline int room_neighbours(const maze_grid &grid, std::uint64_t id, std::uint64_t *ids, std::uint8_t *moves) {
+    std::uint8_t byte = room_byte(grid, id);
+    int walls = byte >> 4, type = cell_type_of(byte), count = 0;
+    std::uint64_t layer_rooms = (std::uint64_t)grid.width * grid.height;
+
+    if (!(walls & WALL_LEFT)) { ids[count] = id - 1; moves[count++] = MOVE_LEFT; }
+    if (!(walls & WALL_RIGHT)) { ids[count] = id + 1; moves[count++] = MOVE_RIGHT; }
+    if (!(walls & WALL_BACK)) { ids[count] = id - grid.width; moves[count++] = MOVE_BACK; }
+    if (!(walls & WALL_FRONT)) { ids[count] = id + grid.width; moves[count++] = MOVE_FRONT; }
+    if (type == 2 && id + layer_rooms < layer_rooms * grid.layers && cell_type_of(room_byte(grid, id + layer_rooms)) != 1) {
+        ids[count] = id + layer_rooms;
+        moves[count++] = MOVE_UP;
+    }
+    if (type == 3 && id >= layer_rooms && cell_type_of(room_byte(grid, id - layer_rooms)) != 1) {
+        ids[count] = id - layer_rooms;
+        moves[count++] = MOVE_DOWN;
+    }
+    return count;
+}
+
+// Room reached by a move
+inline maze_cell moved_cell(maze_cell cell, int move) {
+    const int columns[6] = {-1, 1, 0, 0, 0, 0};
+    const int rows[6] = {0, 0, -1, 1, 0, 0};
+    const int layers[6] = {0, 0, 0, 0, 1, -1};
+    cell.column += columns[move];
+    cell.row += rows[move];
+    cell.layer += layers[move];
+    return cell;
+}
+
+
+// Walking the moves back from a room to the start of the search (path from start to room, both included)
+inline void trace_path(const maze_grid &grid, const path_search &search, std::uint64_t from, std::uint64_t to, std::vector<maze_cell> &path) {
+    std::uint64_t layer_rooms = (std::uint64_t)grid.width * grid.height;
+    path.clear();
+    for (std::uint64_t id = to;; ) {
+        path.push_back(room_cell(grid, id));
+        if (id == from)
+            break;
+        switch (search.moves[id]) {
+            case MOVE_LEFT: id += 1; break;
+            case MOVE_RIGHT: id -= 1; break;
+            case MOVE_BACK: id += grid.width; break;
+            case MOVE_FRONT: id -= grid.width; break;
+            case MOVE_UP: id -= layer_rooms; break;
+            default: id += layer_rooms; break;
+        }
+    }
+    std::reverse(path.begin(), path.end());
+}
+
+
+// Breadth-first search from a room. With a target, stops there and returns its distance (-1 when unreachable)
+// and the path (optional). Without one (to = null), fills distances (optional, -1 for unreachable rooms)
+// and returns the number of rooms reached
+inline long long bfs_search(const maze_model &maze, path_search &search, const maze_cell &from, const maze_cell *to, std::vector<int> *distances, std::vector<maze_cell> *path) {
+    const maze_grid &grid = maze.grid;
+    if (distances)
+        distances->assign(search.rooms, -1);
+    if (!walkable(grid, from))
+        return to ? -1 : 0;
+    std::fill(search.visited.begin(), search.visited.end(), 0);
+
+    std::uint64_t start = room_id(grid, from);
+    std::uint64_t target = to ? room_id(grid, *to) : ~(std::uint64_t)0;
+    search.frontier.assign(1, start);
+    test_and_visit(search, start);
+    long long reached = 1;
+    std::uint64_t ids[6];
+    std::uint8_t moves[6];
+    for (int distance = 0; !search.frontier.empty(); ++distance) {
+        search.next.clear();
+        for (std::size_t k = 0; k < search.frontier.size(); ++k) {
+            std::uint64_t id = search.frontier[k];
+            if (distances)
+                (*distances)[id] = distance;
+            if (id == target) {
+                if (path)
+                    trace_path(grid, search, start, target, *path);
+                return distance;
+            }
+            int count = room_neighbours(grid, id, ids, moves);
+            for (int n = 0; n < count; ++n) {
+                if (test_and_visit(search, ids[n])) {
+                    search.moves[ids[n]] = moves[n];
+                    search.next.push_back(ids[n]);
+                    ++reached;
+                }
+            }
+        }
+        search.frontier.swap(search.next);
+    }
+    return to ? -1 : reached;
+}
+
+
+// Lower bound of the moves between two rooms: the moves inside a layer plus one per floor change
+inline std::uint32_t path_heuristic(const maze_cell &a, const maze_cell &b) {
+    return (std::uint32_t)(std::abs(a.column - b.column) + std::abs(a.row - b.row) + std::abs(a.layer - b.layer));
+}
+
+// Heap order: lowest f first, then lowest h (deepest room, fewer rooms expanded on ties)
+inline bool open_after(const open_entry &a, const open_entry &b) {
+    return a.f > b.f || (a.f == b.f && a.h > b.h);
+}
+
+
+// A* search between two rooms: returns the distance (-1 when unreachable) and the path (optional), expanded counts
+// the rooms taken off the heap (optional). The heuristic is consistent, so a room is final the first time it
+// leaves the heap (stale entries are skipped)
+inline long long astar_search(const maze_model &maze, path_search &search, const maze_cell &from, const maze_cell &to, std::vector<maze_cell> *path, long long *expanded = nullptr) {
+    const maze_grid &grid = maze.grid;
+    if (!walkable(grid, from) || !walkable(grid, to))
+        return -1;
+    std::fill(search.visited.begin(), search.visited.end(), 0);
+
+    std::uint64_t start = room_id(grid, from), target = room_id(grid, to);
+    std::vector<open_entry> &open = search.open;
+    open_entry first = {path_heuristic(from, to), path_heuristic(from, to), start << 3};
+    open.assign(1, first);
+    std::uint64_t ids[6];
+    std::uint8_t moves[6];
+
+    while (!open.empty()) {
+        std::pop_heap(open.begin(), open.end(), open_after);
+        open_entry entry = open.back();
+        open.pop_back();
+        std::uint64_t id = entry.room >> 3;
+        if (!test_and_visit(search, id))
+            continue;
+        if (expanded)
+            ++*expanded;
+        search.moves[id] = (std::uint8_t)(entry.room & 7);
+        maze_cell cell = room_cell(grid, id);
+        std::uint32_t g = entry.f - entry.h;
+        if (id == target) {
+            if (path)
+                trace_path(grid, search, start, target, *path);
+            return (long long)g;
+        }
+
+        int count = room_neighbours(grid, id, ids, moves);
+        for (int n = 0; n < count; ++n) {
+            if (search.visited[ids[n] >> 6] >> (ids[n] & 63) & 1)
+                continue;
+            std::uint32_t h = path_heuristic(moved_cell(cell, moves[n]), to);
+            open_entry next = {g + 1 + h, h, ids[n] << 3 | moves[n]};
+            open.push_back(next);
+            std::push_heap(open.begin(), open.end(), open_after);
+        }
+    }
+    return -1;
+}
+#endif
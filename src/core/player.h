@@ -0,0 +1,294 @@
+#ifndef PLAYER_H
+#define PLAYER_H
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "../dependencies/GLM/glm.hpp"
+#include "../dependencies/UTILS/deterministic_math.h"
+#include "maze_model.h"
+
+
+// Player state and game rules, advanced one step at a time. No GL or GLFW in here.
+
+// Room dimensions used by the collision //
+const float ROOM_SIZE = 100.0f;         // Rooms are 100 units wide, centered on 100 * (column, row)
+const float PLAYER_RADIUS = 1.0f;       // Half-size of the square collider around the camera
+const float PICKUP_DISTANCE = 5.0f;     // Items and elevators trigger this close to the room center
+const float PLAYER_SPEED = 40.25f;      // Strafe speed, moving forward/backward is 1.5 times faster
+
+// Keyboard and mouse state driving one step
+enum input_keys { KEY_FORWARD = 1, KEY_BACKWARD = 2, KEY_LEFT = 4, KEY_RIGHT = 8, KEY_RESTART = 16, KEY_ROUTE = 32, KEY_EDIT = 64 };
+typedef struct input_state {
+    int keys;
+    float yaw;
+    float pitch;
+}input_state;
+
+// What happened during a step, so a frontend can react (print the map, restart, ...)
+enum step_events { EVENT_ROOM_CHANGED = 1, EVENT_COLLECTED = 2, EVENT_LAYER_CHANGED = 4, EVENT_WON = 8 };
+
+typedef struct player_state {
+    glm::vec3 position;
+    int layer;
+    std::pair<int, int> element_position;   // (column, row) of the current room
+    int collectables;                       // Number of items that have already been collected
+}player_state;
+
+
+// Placing the player on the start room
+inline void reset_player(player_state &player, const maze_model &maze) {
+    player.layer = 0;
+    player.element_position = maze.initial_element_position;
+    player.position = ROOM_SIZE * cell_position(player.element_position.first, player.element_position.second);
+    player.collectables = 0;
+}
+
+
+// Direction the camera looks at given the mouse angles (bit-identical on every machine)
+inline glm::vec3 camera_direction(float yaw, float pitch) {
+    float sin_yaw, cos_yaw, sin_pitch, cos_pitch;
+    deterministic_sin_cos(yaw, sin_yaw, cos_yaw);
+    deterministic_sin_cos(pitch, sin_pitch, cos_pitch);
+
+    glm::vec3 direction;
+    direction.x = cos_yaw * cos_pitch;
+    direction.y = sin_pitch;
+    direction.z = sin_yaw * cos_pitch;
+    return glm::normalize(direction);
+}
+
+
+// Room (column or row) containing a world coordinate
+inline int room_index(float coordinate) {
+    return (int)std::floor((coordinate + 0.5f * ROOM_SIZE) / ROOM_SIZE);
+}
+
+
+// Checking if a room has a wall on one side (0: -X, 1: +X, 2: -Z, 3: +Z), the layer border counts as a wall
+inline bool wall_ahead(const maze_model &maze, int layer, int column, int row, int side) {
+    int next_column = column + (side == 0 ? -1 : side == 1 ? 1 : 0);
+    int next_row = row + (side == 2 ? -1 : side == 3 ? 1 : 0);
+    if (!inside_grid(maze.grid, layer, column, row) || !inside_grid(maze.grid, layer, next_column, next_row))
+        return true;
+    return (cell_walls(maze.grid, layer, column, row) >> side) & 1;
+}
+
+
+// Boundary crossings of the collider moving along one axis (0: X, 2: Z)
+typedef struct axis_sweep {
+    int step;           // -1 or 1
+    int side;           // Side of the rooms the leading face exits through (see wall_ahead)
+    int room;           // Room (column or row) the leading face is in
+    float boundary;     // Boundary it exits through next
+    float target;       // Where the leading face stops without a wall
+}axis_sweep;
+
+inline axis_sweep start_axis_sweep(const glm::vec3 &position, int axis, float distance) {
+    float half_room = 0.5f * ROOM_SIZE;
+    axis_sweep sweep;
+    sweep.step = distance > 0.0f ? 1 : -1;
+    sweep.side = (axis == 0 ? 0 : 2) + (sweep.step > 0 ? 1 : 0);
+    float lead = position[axis] + sweep.step * PLAYER_RADIUS;  // Collider face moving forward
+    sweep.target = lead + distance;
+    sweep.room = sweep.step > 0 ? (int)std::ceil((lead - half_room) / ROOM_SIZE) : (int)std::floor((lead + half_room) / ROOM_SIZE);
+    sweep.boundary = ROOM_SIZE * (float)sweep.room + sweep.step * half_room;
+    return sweep;
+}
+
+// Checking if the leading face crosses its next boundary before the end of the move
+inline bool crosses_boundary(const axis_sweep &sweep) {
+    return sweep.step > 0 ? sweep.target > sweep.boundary : sweep.target < sweep.boundary;
+}
+
+// Checking the next boundary for a wall face, with the collider at coordinate other_position on the other axis
+// (it overlaps at most two rooms there)
+inline bool boundary_blocked(const maze_model &maze, int layer, int axis, const axis_sweep &sweep, float other_position) {
+    float half_room = 0.5f * ROOM_SIZE;
+    int first = (int)std::floor((other_position - PLAYER_RADIUS + half_room) / ROOM_SIZE);
+    int last = (int)std::ceil((other_position + PLAYER_RADIUS - half_room) / ROOM_SIZE);
+    for (int k = first; k <= last; ++k) {
+        bool blocked = axis == 0 ? wall_ahead(maze, layer, sweep.room, k, sweep.side) : wall_ahead(maze, layer, k, sweep.room, sweep.side);
+        if (blocked)
+            return true;
+    }
+    return false;
+}
+
+
+// Sweeping the player collider along one axis (0: X, 2: Z), walking the rooms crossed (DDA)
+// and stopping at the first wall face, so the cost is O(rooms crossed) whatever the distance
+inline void sweep_axis(const maze_model &maze, int layer, glm::vec3 &position, int axis, float distance) {
+    if (distance == 0.0f)
+        return;
+    axis_sweep sweep = start_axis_sweep(position, axis, distance);
+    for (; crosses_boundary(sweep); sweep.room += sweep.step, sweep.boundary += sweep.step * ROOM_SIZE) {
+        if (boundary_blocked(maze, layer, axis, sweep, position[2 - axis])) {
+            position[axis] = sweep.boundary - sweep.step * PLAYER_RADIUS;
+            return;
+        }
+    }
+    position[axis] += distance;
+}
+
+
+// Moving the player with collision along the straight segment of the displacement: the X and Z boundaries the
+// collider crosses are walked in the order the segment reaches them (by its parameter t), each one checked where
+// the collider is at that t. The first wall face stops its axis there, the rest of the other axis is then swept
+// on its own (the player slides along the wall). The cost is O(rooms crossed) whatever the step length
+inline void sweep_move(const maze_model &maze, int layer, glm::vec3 &position, glm::vec3 displacement) {
+    if (displacement.x == 0.0f || displacement.z == 0.0f) {
+        sweep_axis(maze, layer, position, 0, displacement.x);
+        sweep_axis(maze, layer, position, 2, displacement.z);
+        return;
+    }
+    axis_sweep sweeps[2] = {start_axis_sweep(position, 0, displacement.x), start_axis_sweep(position, 2, displacement.z)};
+    float distances[2] = {displacement.x, displacement.z};
+    for (;;) {
+        // Next boundary reached (X first on a tie)
+        float t[2];
+        for (int k = 0; k < 2; ++k) {
+            float lead = position[2 * k] + sweeps[k].step * PLAYER_RADIUS;
+            t[k] = crosses_boundary(sweeps[k]) ? std::min(std::max((sweeps[k].boundary - lead) / distances[k], 0.0f), 1.0f) : 2.0f;
+        }
+        int k = t[1] < t[0] ? 1 : 0;
+        if (t[k] > 1.0f)
+            break;
+        int axis = 2 * k, other = 2 - axis;
+        const axis_sweep &next = sweeps[1 - k];
+        float other_position = position[other] + t[k] * distances[1 - k];
+        // Rounding never takes the collider past a boundary of the other axis that is not checked yet
+        float other_lead = other_position + next.step * PLAYER_RADIUS;
+        if (crosses_boundary(next) && (next.step > 0 ? other_lead > next.boundary : other_lead < next.boundary))
+            other_position = next.boundary - next.step * PLAYER_RADIUS;
+        if (boundary_blocked(maze, layer, axis, sweeps[k], other_position)) {
+            position[axis] = sweeps[k].boundary - sweeps[k].step * PLAYER_RADIUS;
+            position[other] = other_position;
+            sweep_axis(maze, layer, position, other, (1.0f - t[k]) * distances[1 - k]);
+            return;
+        }
+        sweeps[k].room += sweeps[k].step;
+        sweeps[k].boundary += sweeps[k].step * ROOM_SIZE;
+    }
+    position.x += displacement.x;
+    position.z += displacement.z;
+}
+
+
+// Checking if the player stands on the center of its room
+inline bool at_room_center(const player_state &player) {
+    float room_x = ROOM_SIZE * (float)player.element_position.first;
+    float room_z = ROOM_SIZE * (float)player.element_position.second;
+    return player.position.x <= room_x + PICKUP_DISTANCE && player.position.x >= room_x - PICKUP_DISTANCE && player.position.z <= room_z + PICKUP_DISTANCE && player.position.z >= room_z - PICKUP_DISTANCE;
+}
+
+
+// Moving the player by dt seconds with collision, without changing the maze. Returns the step_events that happened
+inline int move_player(const maze_model &maze, player_state &player, const input_state &input, float dt) {
+    int events = 0;
+
+    // Player speed
+    const float camera_speed = PLAYER_SPEED * dt;
+    // Colision in Y-axis
+    const glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::vec3 front = camera_direction(input.yaw, input.pitch);
+    glm::vec3 front_aux = glm::vec3((float)front.x, 0.0f, (float)front.z);
+
+    // Player movement
+    glm::vec3 displacement = glm::vec3(0.0f, 0.0f, 0.0f);
+    if (input.keys & KEY_FORWARD)
+        displacement += (1.5f * camera_speed) * front_aux;
+    if (input.keys & KEY_BACKWARD)
+        displacement -= (1.5f * camera_speed) * front_aux;
+    if (input.keys & KEY_LEFT)
+        displacement -= glm::normalize(glm::cross(front_aux, up)) * camera_speed;
+    if (input.keys & KEY_RIGHT)
+        displacement += glm::normalize(glm::cross(front_aux, up)) * camera_speed;
+
+    // Colision in X-axis and Z-axis: the whole displacement is swept against the wall grid
+    sweep_move(maze, player.layer, player.position, displacement);
+
+    // When the player enter in another maze element
+    std::pair<int, int> element_position = std::make_pair(room_index(player.position.x), room_index(player.position.z));
+    if (element_position != player.element_position) {
+        player.element_position = element_position;
+        events |= EVENT_ROOM_CHANGED;
+    }
+    return events;
+}
+
+
+// When the player pass through an elevator (the room above/below has the same coordinates). An elevator leads
+// nowhere when the layer it goes to does not exist or its room there is a wall (as in room_neighbours)
+inline int take_elevator(const maze_model &maze, player_state &player) {
+    const maze_grid &grid = maze.grid;
+    int column = player.element_position.first, row = player.element_position.second;
+    if (!at_room_center(player) || !inside_grid(grid, player.layer, column, row))
+        return 0;
+    int type = cell_type(grid, player.layer, column, row);
+    int layer = type == 2 ? player.layer + 1 : type == 3 ? player.layer - 1 : player.layer;
+    if (layer == player.layer || layer < 0 || layer >= grid.layers || cell_type(grid, layer, column, row) == 1)
+        return 0;
+    player.layer = layer;
+    return EVENT_LAYER_CHANGED;
+}
+
+
+// Checking if the player has collected all items and is back to the start
+inline bool player_won(const maze_model &maze, const player_state &player) {
+    return player.collectables == maze.total_collectables && player.layer == 0 && player.element_position == maze.initial_element_position;
+}
+
+
+// Advancing the player by dt seconds: movement, collision, collectables, elevators and the win condition.
+// Collected items are removed from the maze (and marked as picked). Returns the step_events that happened
+inline int step(maze_model &maze, player_state &player, const input_state &input, float dt) {
+    int events = move_player(maze, player, input, dt);
+
+    // When the player pick up a collectable item
+    if (cell_type(maze.grid, player.layer, player.element_position.first, player.element_position.second) == 4 && at_room_center(player)) {
+        pick_collectable(maze, grid_index(maze.grid, player.layer, player.element_position.first, player.element_position.second)); // Transforming in an empty room
+        player.collectables += 1;
+        events |= EVENT_COLLECTED;
+    }
+    else
+        events |= take_elevator(maze, player);
+
+    if (player_won(maze, player))
+        events |= EVENT_WON;
+
+    return events;
+}
+
+
+// Game state that can be saved and restored in memory: the player and the picked items
+typedef struct game_checkpoint {
+    player_state player;
+    std::vector<std::uint64_t> picked;
+}game_checkpoint;
+
+inline void save_checkpoint(const maze_model &maze, const player_state &player, game_checkpoint &checkpoint) {
+    checkpoint.player = player;
+    checkpoint.picked = maze.picked;
+}
+
+// Only the items picked or put back since the checkpoint are changed in the maze
+inline void restore_checkpoint(maze_model &maze, player_state &player, const game_checkpoint &checkpoint) {
+    restore_collectables(maze, &checkpoint.picked);
+    player = checkpoint.player;
+}
+
+// Starting over without reloading the maze: every item is put back and the player is on the start room
+inline void restart_game(maze_model &maze, player_state &player) {
+    restore_collectables(maze);
+    reset_player(player, maze);
+}
+
+
+// Loading the rooms around the player and ahead along the view direction, for paged mazes (nothing otherwise)
+inline void prefetch_ahead(maze_model &maze, const player_state &player, const input_state &input) {
+    glm::vec3 direction = camera_direction(input.yaw, input.pitch);
+    prefetch_cells(maze.grid, player.layer, player.element_position.first, player.element_position.second, direction.x, direction.z);
+}
+#endif
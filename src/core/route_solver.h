@@ -0,0 +1,510 @@
+#ifndef ROUTE_SOLVER_H
+#define ROUTE_SOLVER_H
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../dependencies/UTILS/triple_buffer.h"
+#include "frontier_bfs.h"
+#include "maze_edit.h"
+
+
+// Shortest route that wins the game from a room: every collectable left is picked and the route ends on the start
+// room of layer 0 (player_won). The distances between the route points (the room, the items and the start) come
+// from a bitmask BFS per source (frontier_bfs.h), the sources searched at once on the pool threads. The elevators
+// are edges of these searches, so the distances already cross floors.
+// The visiting order is exact (Held-Karp) up to HELD_KARP_ITEMS items, otherwise nearest neighbour improved with
+// 2-opt and Or-opt moves until no move helps or the time budget is spent. Distances are not symmetric (an elevator
+// only goes one way), 2-opt prices a reversed segment with the distances of its reversed moves.
+// The time budget covers the whole solve. A route_solver keeps the search states and the distances from the items
+// between solves, and a route_worker runs the solves on a thread of its own for the game.
+
+const int HELD_KARP_ITEMS = 16;
+const std::uint32_t ROUTE_UNREACHABLE = 0xFFFFFFFFu;
+const std::size_t ROUTE_MEMORY_BUDGET = (std::size_t)1 << 30;      // Search states of the sources searched at once
+
+// Distances between the route points, cost(a, b) from point a (a source) to point b
+typedef struct route_table {
+    const std::uint32_t *distances;
+    std::size_t columns;
+
+    long long operator()(int a, int b) const {
+        return (long long)distances[(std::size_t)a * columns + b];
+    }
+}route_table;
+
+typedef struct maze_route {
+    long long length;                   // Moves of the route, -1 when there is none
+    bool exact;                         // The order is optimal (otherwise the best found in the time budget)
+    bool timed_out;                     // The time budget ran out before the route was found
+    std::vector<int> order;             // Collectable ids in visiting order
+    std::vector<int> unreachable;       // Collectables with no way there and back to the start
+    std::vector<maze_cell> cells;       // Every room of the route, from the first room to the start room
+}maze_route;
+
+// Reusable solver state, kept from one solve to the next: the bitmask BFS states (block masks built on the first
+// solve, kept in step with route_solver_edited), the A* state of the legs and the distances from every collectable
+// searched so far. Picking items does not change them, so a solve after a pickup only searches from the room
+typedef struct route_solver {
+    std::vector<bit_search> searches;                       // One per pool thread, as many as the memory budget allows
+    path_search legs;
+    std::vector<maze_cell> points;                          // Every collectable (by id), then the start room
+    std::vector<std::pair<std::uint64_t, int> > targets;    // Walkable points by block and bit (block << 6 | bit)
+    std::vector<std::uint64_t> target_bits;                 // Bits of every block holding a point
+    std::vector<std::uint32_t> distances;                   // From every collectable (rows) to every point
+    std::vector<std::uint8_t> searched;                     // Rows of distances searched to the end
+}route_solver;
+
+// Collectables not picked yet (ids into collectable_cells)
+inline std::vector<int> remaining_collectables(const maze_model &maze) {
+    std::vector<int> items;
+    for (int id = 0; id < (int)maze.collectable_cells.size(); ++id)
+        if (!(maze.picked[id >> 6] >> (id & 63) & 1))
+            items.push_back(id);
+    return items;
+}
+
+
+// Points of the solver by block and bit, the walkable ones only (a picked item may have been walled up since)
+inline void route_targets(route_solver &solver, const maze_model &maze) {
+    const bit_search &search = solver.searches[0];
+    solver.targets.clear();
+    solver.target_bits.assign(search.blocks, 0);
+    for (int p = 0; p < (int)solver.points.size(); ++p) {
+        const maze_cell &point = solver.points[p];
+        if (!walkable(maze.grid, point))
+            continue;
+        std::size_t b = block_of(search, point.layer, point.column, point.row);
+        std::uint64_t bit = block_bit(point.column, point.row);
+        solver.targets.push_back(std::make_pair((std::uint64_t)b << 6 | __builtin_ctzll(bit), p));
+        solver.target_bits[b] |= bit;
+    }
+    std::sort(solver.targets.begin(), solver.targets.end());
+}
+
+// Allocating the solver state of a maze (again when another maze is loaded): the block masks, a search state per
+// pool thread within the memory budget, the points and an empty distance table
+inline void prepare_route_solver(route_solver &solver, const maze_model &maze, ThreadPool *pool = nullptr) {
+    const maze_grid &grid = maze.grid;
+    bit_search prototype;
+    prepare_bit_search(prototype, maze, pool);
+    std::size_t state_bytes = prototype.blocks * (sizeof(block_masks) + 3 * sizeof(std::uint64_t) + sizeof(std::uint32_t));
+    int workers = pool ? (int)pool->size() : 1;
+    workers = std::max(1, std::min(workers, (int)(ROUTE_MEMORY_BUDGET / std::max<std::size_t>(state_bytes, 1))));
+    solver.searches.assign(workers - 1, prototype);
+    solver.searches.insert(solver.searches.begin(), std::move(prototype));
+    prepare_search(solver.legs, maze);
+
+    solver.points.resize(maze.collectable_cells.size());
+    for (std::size_t id = 0; id < maze.collectable_cells.size(); ++id)
+        index_position(grid, maze.collectable_cells[id], solver.points[id].layer, solver.points[id].column, solver.points[id].row);
+    maze_cell home = {0, maze.initial_element_position.first, maze.initial_element_position.second};
+    solver.points.push_back(home);
+    route_targets(solver, maze);
+    solver.distances.assign(maze.collectable_cells.size() * solver.points.size(), ROUTE_UNREACHABLE);
+    solver.searched.assign(maze.collectable_cells.size(), 0);
+}
+
+// Keeping a prepared solver in step with a room edit (edit_room, already applied): the block masks follow and the
+// distances are searched again
+inline void route_solver_edited(route_solver &solver, const maze_model &maze, int layer, int column, int row) {
+    if (solver.searches.empty())
+        return;
+    for (std::size_t s = 0; s < solver.searches.size(); ++s)
+        update_block_masks(solver.searches[s], maze, layer, column, row);
+    route_targets(solver, maze);
+    std::fill(solver.searched.begin(), solver.searched.end(), 0);
+}
+
+
+// Distances from every source to every point of the solver into rows[s] (ROUTE_UNREACHABLE when there is no way).
+// One bitmask BFS per source, ended once every point is reached. The sources are shared out between the search
+// states (pool threads), a single source uses them all. done[s] tells the rows completed before the deadline
+inline void route_distances(route_solver &solver, const maze_model &maze, const std::vector<maze_cell> &sources, const std::vector<std::uint32_t*> &rows, std::vector<std::uint8_t> &done, std::chrono::steady_clock::time_point deadline, ThreadPool *pool = nullptr) {
+    std::size_t columns = solver.points.size();
+    int count = (int)sources.size();
+    int workers = std::max(1, std::min((int)solver.searches.size(), count));
+    done.assign(count, 0);
+    std::function<void(int, int)> run = [&](int begin, int end) {
+        for (int w = begin; w < end; ++w) {
+            for (int s = w; s < count && std::chrono::steady_clock::now() < deadline; s += workers) {
+                std::atomic<long long> missing((long long)solver.targets.size());
+                std::atomic<bool> expired(false);
+                std::uint32_t *row = rows[s];
+                std::fill(row, row + columns, ROUTE_UNREACHABLE);
+                bit_bfs_visit(solver.searches[w], maze, sources[s], [&](std::size_t b, std::uint64_t rooms, int distance) {
+                    for (std::uint64_t found = rooms & solver.target_bits[b]; found; found &= found - 1) {
+                        std::uint64_t key = (std::uint64_t)b << 6 | __builtin_ctzll(found);
+                        std::vector<std::pair<std::uint64_t, int> >::const_iterator target = std::lower_bound(solver.targets.begin(), solver.targets.end(), std::make_pair(key, -1));
+                        for (; target != solver.targets.end() && target->first == key; ++target) {
+                            row[target->second] = (std::uint32_t)distance;
+                            --missing;
+                        }
+                    }
+                    // The clock is read once every 64 blocks
+                    if ((b & 63) == 0 && std::chrono::steady_clock::now() >= deadline)
+                        expired = true;
+                    return missing > 0 && !expired;
+                }, workers == 1 ? pool : nullptr);
+                done[s] = missing <= 0 || !expired;
+            }
+        }
+    };
+    if (workers > 1)
+        pool->parallel_for(workers, 1, run);
+    else
+        run(0, 1);
+}
+
+
+// Visiting order of the items 1..items by dynamic programming over the subsets, from point 0 to point items + 1
+inline std::vector<int> held_karp_order(int items, const route_table &cost) {
+    std::vector<int> order;
+    if (items == 0)
+        return order;
+    const long long none = LLONG_MAX;
+    std::size_t subsets = (std::size_t)1 << items;
+    std::vector<long long> best(subsets * items, none);     // Shortest walk through a subset ending on an item
+    std::vector<std::int8_t> previous(subsets * items, -1);
+    for (int i = 0; i < items; ++i)
+        best[((std::size_t)1 << i) * items + i] = cost(0, i + 1);
+    for (std::size_t subset = 1; subset < subsets; ++subset) {
+        for (int i = 0; i < items; ++i) {
+            long long walk = best[subset * items + i];
+            if (!(subset >> i & 1) || walk == none)
+                continue;
+            for (int j = 0; j < items; ++j) {
+                if (subset >> j & 1)
+                    continue;
+                std::size_t extended = (subset | (std::size_t)1 << j) * items + j;
+                long long length = walk + cost(i + 1, j + 1);
+                if (length < best[extended]) {
+                    best[extended] = length;
+                    previous[extended] = (std::int8_t)i;
+                }
+            }
+        }
+    }
+
+    std::size_t subset = subsets - 1;
+    int last = 0;
+    for (int i = 1; i < items; ++i)
+        if (best[subset * items + i] + cost(i + 1, items + 1) < best[subset * items + last] + cost(last + 1, items + 1))
+            last = i;
+    while (last >= 0) {
+        order.push_back(last + 1);
+        int before = previous[subset * items + last];
+        subset &= ~((std::size_t)1 << last);
+        last = before;
+    }
+    std::reverse(order.begin(), order.end());
+    return order;
+}
+
+
+// Lengths of the tour up to every position, walked forward and backward (the end point is no source)
+inline void tour_prefixes(const std::vector<int> &tour, const route_table &cost, std::vector<long long> &forward, std::vector<long long> &backward) {
+    int last = (int)tour.size() - 1;
+    forward.assign(tour.size(), 0);
+    backward.assign(tour.size(), 0);
+    for (int k = 1; k < last; ++k) {
+        forward[k] = forward[k - 1] + cost(tour[k - 1], tour[k]);
+        backward[k] = backward[k - 1] + cost(tour[k], tour[k - 1]);
+    }
+}
+
+
+// One 2-opt pass (reversing tour[i..j], both ends fixed), every improving move found is applied.
+// Returns whether the tour changed
+inline bool two_opt_pass(std::vector<int> &tour, const route_table &cost, std::chrono::steady_clock::time_point deadline) {
+    int last = (int)tour.size() - 1;
+    std::vector<long long> forward, backward;
+    tour_prefixes(tour, cost, forward, backward);
+    bool changed = false;
+    for (int i = 1; i < last - 1 && std::chrono::steady_clock::now() < deadline; ++i) {
+        for (int j = i + 1; j < last; ++j) {
+            long long before = cost(tour[i - 1], tour[i]) + (forward[j] - forward[i]) + cost(tour[j], tour[j + 1]);
+            long long after = cost(tour[i - 1], tour[j]) + (backward[j] - backward[i]) + cost(tour[i], tour[j + 1]);
+            if (after < before) {
+                std::reverse(tour.begin() + i, tour.begin() + j + 1);
+                tour_prefixes(tour, cost, forward, backward);
+                changed = true;
+            }
+        }
+    }
+    return changed;
+}
+
+
+// One Or-opt pass (a run of 1 to 3 items moved elsewhere, same direction), every improving move found is applied.
+// Returns whether the tour changed
+inline bool or_opt_pass(std::vector<int> &tour, const route_table &cost, std::chrono::steady_clock::time_point deadline) {
+    int last = (int)tour.size() - 1;
+    bool changed = false;
+    for (int length = 1; length <= 3; ++length) {
+        for (int s = 1; s + length - 1 < last && std::chrono::steady_clock::now() < deadline; ++s) {
+            int e = s + length - 1;
+            long long removed = cost(tour[s - 1], tour[s]) + cost(tour[e], tour[e + 1]) - cost(tour[s - 1], tour[e + 1]);
+            for (int x = 0; x < last; ++x) {
+                if (x >= s - 1 && x <= e)
+                    continue;
+                long long added = cost(tour[x], tour[s]) + cost(tour[e], tour[x + 1]) - cost(tour[x], tour[x + 1]);
+                if (added < removed) {
+                    std::vector<int> run(tour.begin() + s, tour.begin() + e + 1);
+                    tour.erase(tour.begin() + s, tour.begin() + e + 1);
+                    int at = x < s ? x + 1 : x + 1 - length;
+                    tour.insert(tour.begin() + at, run.begin(), run.end());
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+    return changed;
+}
+
+
+// Visiting order of the items 1..items from point 0 to point items + 1: nearest item first, then 2-opt and Or-opt
+// passes until none helps or time_budget seconds are spent
+inline std::vector<int> heuristic_order(int items, const route_table &cost, double time_budget) {
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(time_budget));
+    std::vector<int> tour(1, 0);
+    std::vector<bool> placed(items + 1, false);
+    for (int k = 0; k < items; ++k) {
+        int nearest = -1;
+        for (int i = 1; i <= items; ++i)
+            if (!placed[i] && (nearest < 0 || cost(tour.back(), i) < cost(tour.back(), nearest)))
+                nearest = i;
+        placed[nearest] = true;
+        tour.push_back(nearest);
+    }
+    tour.push_back(items + 1);
+
+    while (std::chrono::steady_clock::now() < deadline) {
+        bool reversed = two_opt_pass(tour, cost, deadline);
+        bool moved = or_opt_pass(tour, cost, deadline);
+        if (!reversed && !moved)
+            break;
+    }
+    return std::vector<int>(tour.begin() + 1, tour.end() - 1);
+}
+
+
+// Route from a room that picks every collectable left and ends on the start room. time_budget (seconds) bounds
+// the whole solve: the distances still to search, the order (exact up to HELD_KARP_ITEMS items, the best found in
+// the time left beyond) and the rooms of the legs. When it runs out the route has no length and timed_out is set;
+// the distances searched until then are kept by the solver for the next solve
+inline maze_route solve_route(route_solver &solver, const maze_model &maze, const maze_cell &from, ThreadPool *pool = nullptr, double time_budget = 1.0) {
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(time_budget));
+    maze_route route;
+    route.length = -1;
+    route.exact = false;
+    route.timed_out = false;
+    if (solver.searches.empty())
+        prepare_route_solver(solver, maze, pool);
+
+    // Sources: the room, then the items left whose distances were not searched yet
+    std::vector<int> items = remaining_collectables(maze);
+    int count = (int)items.size(), home = (int)solver.points.size() - 1;
+    std::vector<std::uint32_t> from_row(solver.points.size(), ROUTE_UNREACHABLE);
+    std::vector<maze_cell> sources(1, from);
+    std::vector<std::uint32_t*> rows(1, from_row.data());
+    for (int k = 0; k < count; ++k) {
+        if (solver.searched[items[k]])
+            continue;
+        sources.push_back(solver.points[items[k]]);
+        rows.push_back(&solver.distances[(std::size_t)items[k] * solver.points.size()]);
+    }
+    std::vector<std::uint8_t> done;
+    route_distances(solver, maze, sources, rows, done, deadline, pool);
+    for (std::size_t s = 1; s < sources.size(); ++s)
+        if (done[s])
+            solver.searched[(rows[s] - solver.distances.data()) / solver.points.size()] = 1;
+    if (std::find(done.begin(), done.end(), 0) != done.end()) {
+        route.timed_out = true;
+        return route;
+    }
+
+    // Table of the route points: the room (0), the items left (1..count) and the start room (count + 1). Nothing
+    // leads back to the room, those entries cancel out in the 2-opt prices
+    std::size_t columns = count + 2;
+    std::vector<std::uint32_t> distances((count + 1) * columns, ROUTE_UNREACHABLE);
+    for (int a = 0; a <= count; ++a) {
+        const std::uint32_t *row = a == 0 ? from_row.data() : &solver.distances[(std::size_t)items[a - 1] * solver.points.size()];
+        for (int b = 1; b <= count; ++b)
+            distances[a * columns + b] = row[items[b - 1]];
+        distances[a * columns + count + 1] = row[home];
+    }
+    distances[0] = 0;
+    for (int k = 1; k <= count; ++k)
+        if (distances[k] == ROUTE_UNREACHABLE || distances[(std::size_t)k * columns + count + 1] == ROUTE_UNREACHABLE)
+            route.unreachable.push_back(items[k - 1]);
+    if (!route.unreachable.empty() || distances[count + 1] == ROUTE_UNREACHABLE)
+        return route;
+
+    route_table cost = {distances.data(), columns};
+    route.exact = count <= HELD_KARP_ITEMS;
+    double time_left = std::chrono::duration<double>(deadline - std::chrono::steady_clock::now()).count();
+    std::vector<int> order = route.exact ? held_karp_order(count, cost) : heuristic_order(count, cost, std::max(time_left, 0.0));
+
+    // Rooms of the route, leg by leg (none when a leg has no way or the time runs out)
+    std::uint64_t length = 0;
+    int previous = 0;
+    order.push_back(count + 1);
+    std::vector<maze_cell> leg;
+    route.cells.assign(1, from);
+    for (std::size_t k = 0; k < order.size(); ++k) {
+        if (std::chrono::steady_clock::now() >= deadline)
+            route.timed_out = true;
+        const maze_cell &a = previous == 0 ? from : solver.points[items[previous - 1]];
+        const maze_cell &b = order[k] == count + 1 ? solver.points[home] : solver.points[items[order[k] - 1]];
+        if (route.timed_out || astar_search(maze, solver.legs, a, b, &leg) < 0) {
+            route.cells.clear();
+            return route;
+        }
+        length += cost(previous, order[k]);
+        route.cells.insert(route.cells.end(), leg.begin() + 1, leg.end());
+        previous = order[k];
+    }
+    order.pop_back();
+    if (length >= ROUTE_UNREACHABLE) {
+        route.cells.clear();
+        return route;
+    }
+
+    route.length = (long long)length;
+    for (std::size_t k = 0; k < order.size(); ++k)
+        route.order.push_back(items[order[k] - 1]);
+    return route;
+}
+
+// Solving a route once, with a solver state of its own
+inline maze_route solve_route(const maze_model &maze, const maze_cell &from, ThreadPool *pool = nullptr, double time_budget = 1.0) {
+    route_solver solver;
+    return solve_route(solver, maze, from, pool, time_budget);
+}
+
+
+// Route asked of a route_worker: the room it starts from, the items picked and the rooms edited since the last
+// request taken (the worker replays them on its copy of the maze)
+typedef struct route_request {
+    std::uint64_t id;
+    maze_cell from;
+    std::vector<std::uint64_t> picked;
+    std::vector<room_edit> edits;
+}route_request;
+
+typedef struct route_result {
+    std::uint64_t request;              // Id of the request the route answers
+    maze_route route;
+}route_result;
+
+// Routes solved on a thread of their own, on a copy of the maze kept in step by the requests, so that the thread
+// owning the maze never waits for a solve: it posts requests (the newest replaces a waiting one, the edits add up)
+// and takes the newest result from a triple buffer. A solve that runs out of time starts again with twice the
+// budget (the distances searched are kept), unless a newer request is waiting
+typedef struct route_worker {
+    maze_model maze;
+    route_solver solver;
+    double time_budget;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    route_request pending;
+    std::uint64_t requests;             // Requests posted so far
+    bool requested;                     // pending holds a request not taken yet
+    bool stopping;
+    TripleBuffer<route_result> results;
+}route_worker;
+
+
+inline void route_worker_loop(route_worker &worker) {
+    route_request request;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(worker.mutex);
+            worker.wake.wait(lock, [&] { return worker.requested || worker.stopping; });
+            if (worker.stopping)
+                return;
+            std::swap(request, worker.pending);
+            worker.pending.edits.clear();
+            worker.requested = false;
+        }
+
+        // The maze as the requester saw it: items first (an edit may close a picked item), then the edits
+        restore_collectables(worker.maze, &request.picked);
+        for (std::size_t k = 0; k < request.edits.size(); ++k) {
+            const room_edit &edit = request.edits[k];
+            if (edit_room(worker.maze, edit.layer, edit.column, edit.row, edit.type))
+                route_solver_edited(worker.solver, worker.maze, edit.layer, edit.column, edit.row);
+        }
+
+        maze_route route;
+        bool newer = false;
+        for (double budget = worker.time_budget;; budget *= 2.0) {
+            route = solve_route(worker.solver, worker.maze, request.from, nullptr, budget);
+            if (!route.timed_out)
+                break;
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            if (worker.requested || worker.stopping) {
+                newer = true;
+                break;
+            }
+        }
+        if (newer)
+            continue;
+        route_result &result = worker.results.write_buffer();
+        result.request = request.id;
+        result.route = std::move(route);
+        worker.results.publish();
+    }
+}
+
+// Starting the worker of a loaded maze (copied), time_budget (seconds) is the budget of a first solve
+inline void start_route_worker(route_worker &worker, const maze_model &maze, double time_budget) {
+    worker.maze = maze;
+    worker.solver.searches.clear();
+    worker.time_budget = time_budget;
+    worker.pending.edits.clear();
+    worker.requests = 0;
+    worker.requested = false;
+    worker.stopping = false;
+    worker.thread = std::thread(route_worker_loop, std::ref(worker));
+}
+
+// A room edited in the requester's maze (edit_room), replayed by the worker before its next solve
+inline void route_worker_edited(route_worker &worker, const room_edit &edit) {
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    worker.pending.edits.push_back(edit);
+}
+
+// Asking for the route from a room of the requester's maze, with its items picked so far. Returns the id of the
+// request, the result carries it
+inline std::uint64_t request_route(route_worker &worker, const maze_model &maze, const maze_cell &from) {
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    worker.pending.id = ++worker.requests;
+    worker.pending.from = from;
+    worker.pending.picked = maze.picked;
+    worker.requested = true;
+    worker.wake.notify_one();
+    return worker.requests;
+}
+
+// Stopping the worker thread (a solve under way ends first)
+inline void stop_route_worker(route_worker &worker) {
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.stopping = true;
+        worker.wake.notify_one();
+    }
+    if (worker.thread.joinable())
+        worker.thread.join();
+}
+#endif
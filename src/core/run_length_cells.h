@@ -0,0 +1,75 @@
+#ifndef RUN_LENGTH_CELLS_H
+#define RUN_LENGTH_CELLS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+
+// Run-length encoded rows of cells (read-only): every row is a list of runs (cell byte, end column).
+// A cell is found with a binary search over the runs of its row, a row is decoded run by run.
+// Wall regions and corridors give long runs, random layouts give short ones (5 bytes per run)
+class RunLengthRows {
+    private:
+        int width;
+        std::vector<std::uint64_t> row_starts;  // First run of every row, rows + 1 entries
+        std::vector<std::uint32_t> run_ends;    // Column after the last cell of the run
+        std::vector<std::uint8_t> run_values;
+
+        std::size_t run_at(std::size_t row, int column) const {
+            const std::uint32_t *first = run_ends.data() + row_starts[row];
+            const std::uint32_t *last = run_ends.data() + row_starts[row + 1];
+            return (std::size_t)(std::upper_bound(first, last, (std::uint32_t)column) - run_ends.data());
+        }
+    public:
+        RunLengthRows() : width(0) {}
+
+        // Encoding rows of width cells, row(r, out) writes the cells of row r
+        template <typename RowReader>
+        void encode(std::size_t rows, int row_width, RowReader row) {
+            width = row_width;
+            row_starts.assign(1, 0);
+            run_ends.clear();
+            run_values.clear();
+            std::vector<std::uint8_t> cells(width);
+            for (std::size_t r = 0; r < rows; ++r) {
+                row(r, cells.data());
+                for (int j = 0; j < width; ++j) {
+                    if (j == 0 || cells[j] != run_values.back()) {
+                        run_ends.push_back((std::uint32_t)j + 1);
+                        run_values.push_back(cells[j]);
+                    }
+                    else
+                        run_ends.back() = (std::uint32_t)j + 1;
+                }
+                row_starts.push_back(run_ends.size());
+            }
+            run_ends.shrink_to_fit();
+            run_values.shrink_to_fit();
+        }
+
+        std::uint8_t get(std::size_t row, int column) const {
+            return run_values[run_at(row, column)];
+        }
+
+        // Writing count cells of a row, from first_column on
+        void decode(std::size_t row, int first_column, int count, std::uint8_t *out) const {
+            std::size_t run = run_at(row, first_column);
+            int column = first_column, end = first_column + count;
+            while (column < end) {
+                int run_end = std::min((int)run_ends[run], end);
+                std::memset(out + (column - first_column), run_values[run], run_end - column);
+                column = run_end;
+                ++run;
+            }
+        }
+
+        std::size_t runs() const {
+            return run_ends.size();
+        }
+        std::size_t bytes() const {
+            return row_starts.size() * sizeof(std::uint64_t) + run_ends.size() * (sizeof(std::uint32_t) + sizeof(std::uint8_t));
+        }
+};
+#endif
@@ -0,0 +1,34 @@
+#ifndef DETERMINISTIC_MATH_H
+#define DETERMINISTIC_MATH_H
+
+#include <cmath>
+
+
+// Float math that gives bit-identical results on every IEEE-754 machine.
+// Only +, -, *, / and exact operations (fmod) are used, libm's sin/cos differ between platforms.
+// Compile with -ffp-contract=off so the compiler does not fuse multiply-adds.
+
+// Sine and cosine of an angle given in degrees
+inline void deterministic_sin_cos(float degrees, float &sine, float &cosine) {
+    // Exact reduction to [0, 360)
+    float angle = std::fmod(degrees, 360.0f);
+    if (angle < 0.0f)
+        angle += 360.0f;
+
+    // Quadrant and remainder in [-45, 45] degrees
+    int quadrant = (int)((angle + 45.0f) / 90.0f);
+    float r = (angle - 90.0f * (float)quadrant) * 0.017453292519943295f;
+    float r2 = r * r;
+
+    // Taylor polynomials, accurate to float precision on [-pi/4, pi/4]
+    float s = r * (1.0f - r2 * (1.0f / 6.0f - r2 * (1.0f / 120.0f - r2 * (1.0f / 5040.0f))));
+    float c = 1.0f - r2 * (0.5f - r2 * (1.0f / 24.0f - r2 * (1.0f / 720.0f - r2 * (1.0f / 40320.0f))));
+
+    switch (quadrant & 3) {
+        case 0: sine = s;  cosine = c;  break;
+        case 1: sine = c;  cosine = -s; break;
+        case 2: sine = -s; cosine = -c; break;
+        default: sine = -c; cosine = s; break;
+    }
+}
+#endif
@@ -0,0 +1,107 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+// Whole file mapped in memory, copy-on-write: the bytes can be changed in place,
+// the changes stay private to the process and never reach the file
+class MappedFile {
+	private:
+		unsigned char *bytes;
+		std::size_t length;
+#ifdef _WIN32
+		HANDLE file;
+		HANDLE mapping;
+#endif
+	public:
+		MappedFile() : bytes(nullptr), length(0) {
+#ifdef _WIN32
+			file = INVALID_HANDLE_VALUE;
+			mapping = NULL;
+#endif
+		}
+		~MappedFile() {
+			close();
+		}
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		bool open(const char *file_name) {
+			close();
+#ifdef _WIN32
+			file = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+			if (file == INVALID_HANDLE_VALUE)
+				return false;
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+				close();
+				return false;
+			}
+			length = (std::size_t)size.QuadPart;
+			mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+			if (mapping == NULL) {
+				close();
+				return false;
+			}
+			bytes = (unsigned char*)MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+			if (bytes == NULL) {
+				close();
+				return false;
+			}
+#else
+			int descriptor = ::open(file_name, O_RDONLY);
+			if (descriptor < 0)
+				return false;
+			struct stat status;
+			if (fstat(descriptor, &status) != 0 || status.st_size == 0) {
+				::close(descriptor);
+				return false;
+			}
+			length = (std::size_t)status.st_size;
+			void *address = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, descriptor, 0);
+			::close(descriptor);
+			if (address == MAP_FAILED) {
+				length = 0;
+				return false;
+			}
+			bytes = (unsigned char*)address;
+#endif
+			return true;
+		}
+
+		void close() {
+#ifdef _WIN32
+			if (bytes)
+				UnmapViewOfFile(bytes);
+			if (mapping != NULL)
+				CloseHandle(mapping);
+			if (file != INVALID_HANDLE_VALUE)
+				CloseHandle(file);
+			mapping = NULL;
+			file = INVALID_HANDLE_VALUE;
+#else
+			if (bytes)
+				munmap(bytes, length);
+#endif
+			bytes = nullptr;
+			length = 0;
+		}
+
+		unsigned char* data() const {
+			return bytes;
+		}
+		std::size_t size() const {
+			return length;
+		}
+};
+#endif
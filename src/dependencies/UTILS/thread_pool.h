@@ -0,0 +1,108 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Persistent worker threads running data-parallel loops.
+// parallel_for() splits [0, count) in chunks that workers (and the calling thread) grab
+// until none is left, then returns. It must not be called from inside a task.
+class ThreadPool {
+	private:
+		std::vector<std::thread> workers;
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::condition_variable finished;
+
+		std::function<void(int, int)> job;
+		std::atomic<int> next;
+		int count;
+		int chunk;
+		unsigned long generation;
+		int busy;
+		bool stopping;
+
+		void run_chunks() {
+			for (;;) {
+				int begin = next.fetch_add(chunk);
+				if (begin >= count)
+					return;
+				job(begin, std::min(begin + chunk, count));
+			}
+		}
+
+		void worker_loop() {
+			unsigned long seen = 0;
+			for (;;) {
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					wake.wait(lock, [&] { return stopping || generation != seen; });
+					if (stopping)
+						return;
+					seen = generation;
+				}
+				run_chunks();
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					if (--busy == 0)
+						finished.notify_one();
+				}
+			}
+		}
+	public:
+		// threads = 0 uses every hardware thread (the calling thread counts as one)
+		explicit ThreadPool(unsigned int threads = 0) : next(0), count(0), chunk(1), generation(0), busy(0), stopping(false) {
+			if (threads == 0)
+				threads = std::max(1u, std::thread::hardware_concurrency());
+			for (unsigned int i = 1; i < threads; ++i)
+				workers.emplace_back(&ThreadPool::worker_loop, this);
+		}
+
+		~ThreadPool() {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			wake.notify_all();
+			for (unsigned int i = 0; i < workers.size(); ++i)
+				workers[i].join();
+		}
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		unsigned int size() const {
+			return (unsigned int)workers.size() + 1;
+		}
+
+		// Runs task(begin, end) over [0, count) in chunks of at most chunk_size items
+		void parallel_for(int total, int chunk_size, const std::function<void(int, int)> &task) {
+			chunk_size = std::max(1, chunk_size);
+			if (workers.empty() || total <= chunk_size) {
+				for (int begin = 0; begin < total; begin += chunk_size)
+					task(begin, std::min(begin + chunk_size, total));
+				return;
+			}
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				job = task;
+				count = total;
+				chunk = chunk_size;
+				next = 0;
+				busy = (int)workers.size();
+				++generation;
+			}
+			wake.notify_all();
+			run_chunks();
+
+			std::unique_lock<std::mutex> lock(mutex);
+			finished.wait(lock, [&] { return busy == 0; });
+		}
+};
+#endif
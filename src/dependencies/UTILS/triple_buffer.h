@@ -0,0 +1,43 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+
+
+// Lock-free triple buffer: one producer thread, one consumer thread.
+// The producer always owns a "back" slot and the consumer a "front" slot; the third
+// slot is exchanged atomically, so neither side ever waits for the other.
+template <typename T>
+class TripleBuffer {
+	private:
+		static const unsigned int INDEX_MASK = 3;
+		static const unsigned int DIRTY_BIT = 4;
+
+		T slots[3];
+		std::atomic<unsigned int> middle;
+		unsigned int back;
+		unsigned int front;
+	public:
+		TripleBuffer() : slots(), middle(1), back(0), front(2) {}
+
+		// Producer: slot to be filled before calling publish()
+		T& write_buffer() {
+			return slots[back];
+		}
+		// Producer: hands the back slot over to the consumer
+		void publish() {
+			back = middle.exchange(back | DIRTY_BIT, std::memory_order_acq_rel) & INDEX_MASK;
+		}
+		// Consumer: takes the newest published slot, if any. Returns true when it changed
+		bool update() {
+			if (!(middle.load(std::memory_order_relaxed) & DIRTY_BIT))
+				return false;
+			front = middle.exchange(front, std::memory_order_acq_rel) & INDEX_MASK;
+			return true;
+		}
+		// Consumer: newest slot taken by update()
+		const T& read_buffer() const {
+			return slots[front];
+		}
+};
+#endif
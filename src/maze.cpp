@@ -5,6 +5,10 @@
 #include <vector>
 #include <utility>
 #include <random>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
 
 #include "dependencies/GLAD/glad.h"
 #include "dependencies/GLFW/glfw3.h"
@@ -15,6 +19,13 @@
 #include "dependencies/STB/stb_image.h"
 #include "dependencies/UTILS/shaders.h"
 #include "dependencies/UTILS/read_obj.h"
+#include "dependencies/UTILS/triple_buffer.h"
+
+#include "core/maze_loader.h"
+#include "core/player.h"
+#include "core/route_solver.h"
+#include "core/maze_edit.h"
+#include "core/maze_crowd.h"
 
 
 // Settings //
@@ -22,7 +33,6 @@ const unsigned int SCR_WIDTH = 1024;
 const unsigned int SCR_HEIGHT = 768;
 
 // Camera //
-glm::vec3 camera_pos = glm::vec3(0.0f, 0.0f, 0.0f);
 glm::vec3 camera_front = glm::vec3(0.0f, 0.0f, -1.0f);
 glm::vec3 camera_up = glm::vec3(0.0f, 1.0f,  0.0f);
 
@@ -36,29 +46,49 @@ bool first_mouse = true;
 // Zooming
 float fov   =  45.0f;
 
-// Timing between frames //
-float delta_time = 0.0f;	// Time between current frame and last frame
-float last_frame = 0.0f;    // Time of last frame
-
-// Maze elements attributes //
-int number_of_layers;
-int rows_per_layer;
-
-typedef struct maze_element {
-    int type;
-    glm::vec3 position;
-    int walls[4];   
-}maze_element;
-std::vector<maze_element> layers[100];
-maze_element layer_matrix[100][100];
-
-int current_layer;
-std::pair<int, int> current_element_position;
-std::pair<int, int> initial_element_position;
-maze_element current_element;
-
-int collectables; // Number of items that have already been collected
-int total_collectables;
+// Simulation timing //
+const float SIMULATION_RATE = 120.0f;                   // Game-state updates per second, independent of the frame rate
+const float SIMULATION_STEP = 1.0f / SIMULATION_RATE;   // Time simulated by each tick
+const float MAX_CATCH_UP_TIME = 0.25f;                  // Real time simulated at most after a stall
+const std::size_t MAZE_MEMORY_BUDGET = (std::size_t)512 << 20;  // Binary mazes larger than this are paged in chunks
+const int CROWD_AGENTS = 64;                            // Autonomous collectors sharing the maze (thousands to stress-test)
+const double ROUTE_TIME_BUDGET = 0.5;                   // Time budget of a first route solve (on the route worker's thread)
+
+// Game State //
+// Owned by the simulation thread, the renderer reads it through snapshots
+maze_model maze;
+player_state player;
+layer_view current_layer;           // Layer the player is on, rebound when the layer changes or the maze is reloaded
+std::uint64_t maze_revision = 0;    // Bumped whenever the cells or the layer seen by the renderer change
+std::uint64_t layer_revision = 0;   // Bumped when the whole layer must be copied again (layer change, restart)
+std::vector<std::pair<std::uint64_t, int> > changed_rows;  // Rows of the layer changed since, with their maze_revision
+bool show_route = false;            // Route to the remaining items and back to the start shown on the 2D maze (T key)
+maze_route route;                   // Newest route taken from the worker, for the last request
+std::vector<std::uint64_t> route_rooms;   // Room ids of the route, sorted
+bool route_solving = false;         // A request is posted and its route not taken yet
+std::uint64_t route_wanted = 0;     // Id of the last route request
+route_worker router;                // Solves the routes on its own thread, on a copy of the maze
+int previous_keys = 0;
+ThreadPool crowd_pool(CROWD_AGENTS > 0 ? 0u : 1u);  // Steps the agents, no worker threads without agents
+maze_crowd crowd;
+
+// Simulation & Render Threads //
+// Game state produced by the simulation thread after each tick
+typedef struct game_snapshot {
+    glm::vec3 previous_camera_pos;  // Camera at the previous tick, used for interpolation
+    glm::vec3 camera_pos;
+    double tick_time;               // Steady clock time (seconds) at which the tick was published
+    int width;
+    int height;
+    std::vector<std::uint8_t> layer; // Grid cells of the current layer as seen by the simulation
+    std::uint64_t revision;          // maze_revision the layer was copied at, it is only copied again when stale
+    std::uint64_t layer_revision;    // layer_revision of the copy, only the changed rows are copied while it holds
+    std::vector<float> agents;       // World (x, z) of the agents on the player's layer
+}game_snapshot;
+
+TripleBuffer<input_state> input_buffer;
+TripleBuffer<game_snapshot> snapshot_buffer;
+std::atomic<bool> simulation_running(true);
 
 // Textures //
 unsigned int texture_1, texture_2, texture_3, texture_4, texture_5;
@@ -67,6 +97,7 @@ unsigned int texture_1, texture_2, texture_3, texture_4, texture_5;
 unsigned int room_VBO, room_VAO;
 unsigned int sphere_VBO, sphere_VAO;
 unsigned int elevator_VBO, elevator_VAO;
+unsigned int crowd_VBO, crowd_VAO;
 int sphere_vertices_length = 0;
 int elevator_vertices_length = 0;
 
@@ -74,17 +105,27 @@ int elevator_vertices_length = 0;
 void gpu_data_room(float vertices[], int size);
 void gpu_data_sphere(float vertices[], int size);
 void gpu_data_elevator(float vertices[], int size);
+void gpu_data_crowd();
 void draw_maze_2d();
-void draw_room(maze_element element, Shader shader);
-void draw_sphere(maze_element element, Shader shader);
-void draw_elevator(maze_element element, Shader shader);
-void draw_maze(Shader shader);
-void process_input(GLFWwindow *window);
-void update_view_proj(Shader shader);
+void draw_room(const layer_view &layer, int column, int row, const Shader &shader);
+void draw_sphere(glm::vec3 position, const Shader &shader);
+void draw_elevator(int type, glm::vec3 position, const Shader &shader);
+void draw_maze(const Shader &shader, const game_snapshot &snapshot);
+void draw_crowd(const Shader &shader, const game_snapshot &snapshot);
+void sample_input(GLFWwindow *window);
+void process_input(const input_state &input);
+void update_view_proj(Shader shader, glm::vec3 view_pos);
 void load_textures();
-void load_maze();
+void load_maze_file();
+void restart_maze();
+void solve_maze_route();
+bool take_maze_route();
+void mark_rows_changed(int layer, int first, int last);
+bool edit_maze_room(int layer, int column, int row, int type);
 void bind_textures(unsigned int t_1, unsigned int t_2);
-void player_status();
+void simulation_loop();
+void publish_snapshot(glm::vec3 previous_camera_pos);
+double steady_time();
 
 // Callback functions //
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
@@ -131,6 +172,8 @@ int main() {
     // Shaders initialization //
     Shader shader("./shaders_code/vertex_shader.txt", "./shaders_code/fragment_shader.txt"); // you can name your shader files however you like
     shader.use();
+    // Agents are drawn at once, the sphere instanced at every agent position
+    Shader crowd_shader("./shaders_code/crowd_vertex_shader.txt", "./shaders_code/fragment_shader.txt");
 
     // Initial OpenGL state //
     // Z-Buffer
@@ -149,9 +192,13 @@ int main() {
     // Tell opengl for each sampler to which texture unit it belongs to (only has to be done once)   
     shader.setInt("TextureSampler2D_1", 0);
     shader.setInt("TextureSampler2D_2", 1);
+    crowd_shader.use();
+    crowd_shader.setInt("TextureSampler2D_1", 0);
+    crowd_shader.setInt("TextureSampler2D_2", 1);
+    shader.use();
 
     // Loading the Maze //        
-    load_maze();  
+    load_maze_file();  
     draw_maze_2d();      
    
     // Vertex Data (CPU) // 
@@ -220,32 +267,43 @@ int main() {
     gpu_data_room(room_vertices, sizeof(room_vertices));   
     gpu_data_sphere(sphere_vertices, sphere_vertices_length * sizeof(float));
     gpu_data_elevator(elevator_vertices, elevator_vertices_length * sizeof(float));        
+    gpu_data_crowd();
+
+    // Simulation Thread //
+    // Game state is updated at a fixed rate on its own thread, the render loop only consumes snapshots
+    publish_snapshot(player.position);
+    std::thread simulation_thread(simulation_loop);
 
     // Render Loop //
     while (!glfwWindowShouldClose(window)) {       
-         // Checking if the player has collected all items and won the game
-        player_status();        
-
-        // Time per frame
-        float current_frame = glfwGetTime();
-        delta_time = current_frame - last_frame;
-        last_frame = current_frame;       
-
         // Enabling shaders
         shader.use();       
 
         // input        
-        process_input(window);
+        sample_input(window);
+
+        // Newest game state published by the simulation thread
+        snapshot_buffer.update();
+        const game_snapshot &snapshot = snapshot_buffer.read_buffer();
+
+        // Interpolating the camera between the last two simulation ticks
+        float alpha = glm::clamp((float)((steady_time() - snapshot.tick_time) / SIMULATION_STEP), 0.0f, 1.0f);
+        glm::vec3 view_pos = glm::mix(snapshot.previous_camera_pos, snapshot.camera_pos, alpha);
 
         // Updating the View (Camera) & Projection Matrices
-        update_view_proj(shader);            
+        update_view_proj(shader, view_pos);            
        
         // Cleaning the screen      
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);         
         
         // Rendering Objects (Model Matrix)      
-        draw_maze(shader);                                                
+        draw_maze(shader, snapshot);                                                
+
+        // Agents of the crowd (one instanced draw)
+        crowd_shader.use();
+        update_view_proj(crowd_shader, view_pos);
+        draw_crowd(crowd_shader, snapshot);
 
         // GLFW: Swap buffers
         glfwSwapBuffers(window);       
@@ -254,6 +312,11 @@ int main() {
         glfwPollEvents();
     }
 
+    // Stopping the simulation thread //
+    simulation_running = false;
+    simulation_thread.join();
+    stop_route_worker(router);
+
     // De-allocate resources //    
     glDeleteVertexArrays(1, &room_VAO);
     glDeleteBuffers(1, &room_VBO);
@@ -261,6 +324,8 @@ int main() {
     glDeleteBuffers(1, &sphere_VBO);    
     glDeleteVertexArrays(1, &elevator_VAO);
     glDeleteBuffers(1, &elevator_VBO);
+    glDeleteVertexArrays(1, &crowd_VAO);
+    glDeleteBuffers(1, &crowd_VBO);
 
     // GLFW: terminate, clearing all previously allocated GLFW resources //
     glfwTerminate();   
@@ -346,72 +411,104 @@ void gpu_data_elevator(float vertices[], int size) {
 }
 
 
+// Crowd gpu data: the sphere vertices and one (x, z) position per agent, refilled every frame
+void gpu_data_crowd() {
+    // VBO and VAO initialization 
+    glGenVertexArrays(1, &crowd_VAO);
+    glGenBuffers(1, &crowd_VBO);
+
+    // Bind the Vertex Array Object first,   
+    glBindVertexArray(crowd_VAO);
+
+    // Then the sphere vertex attributes(s).
+    glBindBuffer(GL_ARRAY_BUFFER, sphere_VBO);
+    // Position attribute
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    // Texture coord attribute
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+
+    // Agent position attribute, advancing once per instance
+    glBindBuffer(GL_ARRAY_BUFFER, crowd_VBO);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+
+    // Unbind VAO (optional)
+    glBindVertexArray(0);
+}
+
+
 // Drawing the rooms
-void draw_room(maze_element element, Shader shader) {
+void draw_room(const layer_view &layer, int column, int row, const Shader &shader) {
+    int type = view_type(layer, column, row);
+    glm::vec3 position = cell_position(column, row);
+
     // Binding the textures that we want in the render
     bind_textures(texture_1, texture_2); 
     // Bind the room VAO 
     glBindVertexArray(room_VAO);
 
-    if (element.type == 1) {
+    if (type == 1) {
         // Model Matrix -> Scale - Translate - Rotate
         glm::mat4 model_matrix = glm::mat4(1.0f);        
         model_matrix = glm::scale(model_matrix, glm::vec3(100.0f,30.0f, 100.0f));                 
-        model_matrix = glm::translate(model_matrix, element.position);                              
+        model_matrix = glm::translate(model_matrix, position);                              
         shader.setMat4("model", model_matrix);
         // Draw
         glDrawArrays(GL_TRIANGLES, 0, 36);
     }
-    else if (element.type == 0 || element.type == -1) {
+    else if (type == 0 || type == -1) {
         // Model Matrix -> Scale - Translate - Rotate
         glm::mat4 model_matrix = glm::mat4(1.0f);        
         model_matrix = glm::scale(model_matrix, glm::vec3(100.0f, 30.0f, 100.0f));                 
-        model_matrix = glm::translate(model_matrix, element.position);                              
+        model_matrix = glm::translate(model_matrix, position);                              
         shader.setMat4("model", model_matrix);
         // Draw
         glDrawArrays(GL_TRIANGLES, 24, 36);
     }
-    else if (element.type == 2) {
+    else if (type == 2) {
         // Model Matrix -> Scale - Translate - Rotate
         glm::mat4 model_matrix = glm::mat4(1.0f);        
         model_matrix = glm::scale(model_matrix, glm::vec3(100.0f, 30.0f, 100.0f));                 
-        model_matrix = glm::translate(model_matrix, element.position);                              
+        model_matrix = glm::translate(model_matrix, position);                              
         shader.setMat4("model", model_matrix);
         // Draw
         glDrawArrays(GL_TRIANGLES, 24, 36);
 
         // Draw the elevator to go up
-        draw_elevator(element, shader);
+        draw_elevator(type, position, shader);
     }
-    else if (element.type == 3) {
+    else if (type == 3) {
         // Model Matrix -> Scale - Translate - Rotate
         glm::mat4 model_matrix = glm::mat4(1.0f);        
         model_matrix = glm::scale(model_matrix, glm::vec3(100.0f, 30.0f, 100.0f));                 
-        model_matrix = glm::translate(model_matrix, element.position);                              
+        model_matrix = glm::translate(model_matrix, position);                              
         shader.setMat4("model", model_matrix);
         // Draw
         glDrawArrays(GL_TRIANGLES, 24, 36);
         
         // Draw the elevator to go down        
-        draw_elevator(element, shader);
+        draw_elevator(type, position, shader);
     }
     else {
         // Model Matrix -> Scale - Translate - Rotate
         glm::mat4 model_matrix = glm::mat4(1.0f);        
         model_matrix = glm::scale(model_matrix, glm::vec3(100.0f, 30.0f, 100.0f));                 
-        model_matrix = glm::translate(model_matrix, element.position);                              
+        model_matrix = glm::translate(model_matrix, position);                              
         shader.setMat4("model", model_matrix);
         // Draw
         glDrawArrays(GL_TRIANGLES, 24, 36);        
 
         // Drawing the collectable
-        draw_sphere(element, shader);
+        draw_sphere(position, shader);
     }
 }
 
 
 // Drawing the spheres
-void draw_sphere(maze_element element, Shader shader) {
+void draw_sphere(glm::vec3 position, const Shader &shader) {
     // Binding the textures that we want in the render
     bind_textures(texture_3, 0);    
     // Bind the sphere VAO 
@@ -420,7 +517,7 @@ void draw_sphere(maze_element element, Shader shader) {
     // Model Matrix -> Scale - Translate - Rotate
     glm::mat4 model_matrix = glm::mat4(1.0f);             
     model_matrix = glm::scale(model_matrix, glm::vec3(5.0f, 5.0f, 5.0f));        
-    model_matrix = glm::translate(model_matrix, 20.f * element.position);                                          
+    model_matrix = glm::translate(model_matrix, 20.f * position);                                          
     model_matrix =  glm::rotate(model_matrix, (float)glfwGetTime() * glm::radians(50.0f), glm::vec3(0.25, 0.25f, 0.25f));         
     shader.setMat4("model", model_matrix);
     // Draw
@@ -429,9 +526,9 @@ void draw_sphere(maze_element element, Shader shader) {
 
 
 // Drawing the elevators
-void draw_elevator(maze_element element, Shader shader) {
+void draw_elevator(int type, glm::vec3 position, const Shader &shader) {
     // Binding the textures that we want in the render
-    if (element.type == 2)
+    if (type == 2)
         bind_textures(texture_4, 0); // UP
     else 
         bind_textures(texture_5, 0);  // Down
@@ -442,7 +539,7 @@ void draw_elevator(maze_element element, Shader shader) {
     // Model Matrix -> Scale - Translate - Rotate
     glm::mat4 model_matrix = glm::mat4(1.0f);             
     model_matrix = glm::scale(model_matrix, glm::vec3(5.0f, 5.0f, 5.0f));    
-    model_matrix = glm::translate(model_matrix, 20.f * element.position); 
+    model_matrix = glm::translate(model_matrix, 20.f * position); 
     model_matrix =  glm::rotate(model_matrix, (float)glfwGetTime() * glm::radians(50.0f), glm::vec3(0.0, 1.0f, 0.0f));                                                 
     shader.setMat4("model", model_matrix);
     // Draw
@@ -450,198 +547,158 @@ void draw_elevator(maze_element element, Shader shader) {
 }
 
 
+// Drawing the agents on the player's layer
+void draw_crowd(const Shader &shader, const game_snapshot &snapshot) {
+    int count = (int)(snapshot.agents.size() / 2);
+    if (count == 0)
+        return;
+    // Binding the textures that we want in the render
+    bind_textures(texture_2, 0);
+    // Bind the crowd VAO and upload the agent positions
+    glBindVertexArray(crowd_VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, crowd_VBO);
+    glBufferData(GL_ARRAY_BUFFER, snapshot.agents.size() * sizeof(float), snapshot.agents.data(), GL_STREAM_DRAW);
+
+    // Model Matrix -> Scale (the agent position is added in the shader)
+    glm::mat4 model_matrix = glm::scale(glm::mat4(1.0f), glm::vec3(3.0f, 3.0f, 3.0f));
+    shader.setMat4("model", model_matrix);
+    // Draw
+    glDrawArraysInstanced(GL_TRIANGLES, 0, sphere_vertices_length / 5, count);
+}
+
+
 // 2D maze in order to aid navigation
 void draw_maze_2d() {      
     std::cout << std::endl;  
-    std::cout << "Layer " << current_layer << std::endl;    
-    for (int i = 0; i < rows_per_layer; ++i) {
-        for (int j = 0; j < rows_per_layer; ++j) {
-            if (current_element_position.first == j && current_element_position.second == i)
+    std::cout << "Layer " << player.layer << std::endl;    
+    for (int i = 0; i < maze.grid.height; ++i) {
+        for (int j = 0; j < maze.grid.width; ++j) {
+            int type = view_type(current_layer, j, i);
+            maze_cell cell = {player.layer, j, i};
+            if (player.element_position.first == j && player.element_position.second == i)
                 std::cout << "x ";
-            else if (layers[current_layer][i * rows_per_layer + j].type == -1) 
+            else if (show_route && std::binary_search(route_rooms.begin(), route_rooms.end(), room_id(maze.grid, cell)))
+                std::cout << "* ";
+            else if (type == -1) 
                 std::cout << "-1 ";
-            else if (layers[current_layer][i * rows_per_layer + j].type == 0)
+            else if (type == 0)
                 std::cout << "0 ";
-            else if (layers[current_layer][i * rows_per_layer + j].type == 1) 
+            else if (type == 1) 
                 std::cout << "1 ";
-            else if (layers[current_layer][i * rows_per_layer + j].type == 2) 
+            else if (type == 2) 
                 std::cout << "2 ";
-            else if (layers[current_layer][i * rows_per_layer + j].type == 3) 
+            else if (type == 3) 
                 std::cout << "3 ";
             else 
                 std::cout << "4 ";
         }
         std::cout << std::endl;
     }
-    std::cout << "Items Collected: " << collectables << "/" << total_collectables << std::endl;
+    std::cout << "Items Collected: " << player.collectables << "/" << maze.total_collectables << std::endl;
+    if (show_route && route_solving)
+        std::cout << "Route (*): being solved" << std::endl;
+    else if (show_route && route.length >= 0)
+        std::cout << "Route (*): " << route.length << " moves to collect everything and get back" << std::endl;
+    else if (show_route)
+        std::cout << "Route (*): the remaining items cannot all be collected" << std::endl;
 }
 
 
 // Drawing the maze
-void draw_maze(Shader shader) {
-    // Reading the current layer in a matrix format
-    int index = 0;    
-    for (int i = 0; i < rows_per_layer; ++i) {
-        for (int j = 0; j < rows_per_layer; ++j) {
-            layer_matrix[i][j] = layers[current_layer][index];
-            ++index;
-        }
+void draw_maze(const Shader &shader, const game_snapshot &snapshot) {
+    // Current layer (as published by the simulation thread) read in place, room by room
+    layer_view layer = make_layer_view(snapshot.layer.data(), snapshot.width, snapshot.height);
+    for (int i = 0; i < layer.height; ++i) {
+        for (int j = 0; j < layer.width; ++j)
+            draw_room(layer, j, i, shader);
     }
+}
+
 
-    // Current layer being drawn element by element
-    for (int i = 0; i < rows_per_layer; ++i) {
-        for (int j = 0; j < rows_per_layer; ++j) {             
-            maze_element element = layer_matrix[i][j];
-            draw_room(element, shader);            
-        }            
+// Loading the maze from input file (once) and placing the player on the start room
+void load_maze_file() {    
+    if (!load_maze(maze, "input.txt", nullptr, MAZE_MEMORY_BUDGET)) {
+        std::cout << "Failed to load the maze" << std::endl;
+        exit(-1);
     }
+    create_crowd(crowd, maze, CROWD_AGENTS, 1u, &crowd_pool);
+    start_route_worker(router, maze, ROUTE_TIME_BUDGET);
+    restart_maze();
 }
 
 
-// Loading the maze from input file
-void load_maze() {    
-    // Computing: Total rows, Total columns, Number of layers and Rows per layer
-    int rows = 0, columns = 0;
-    std::string line, item;    
-    std::ifstream file( "input.txt" );
-
-    while(getline(file, line)) {
-        rows++;
-        if ( rows == 1 ) {                              // First row only: determine the number of columns
-      
-            std::stringstream string_stream(line);      // Set up up a stream from this line
-            while (string_stream >> item) 
-                columns++;                              // Each item delineated by spaces adds one to cols               
-        }        
-    }
-    number_of_layers = rows / columns;
-    rows_per_layer = columns;    
-    // std::cout << "\n- File had " << rows << " rows and " << columns << " columns" << " and "<< number_of_layers << " layers -" << std::endl;
+// Starting over from the maze in memory: the picked items are put back and the player is on the start room
+void restart_maze() {
+    restart_game(maze, player);
+    current_layer = view_layer(maze.grid, player.layer);
+    ++maze_revision;
+    ++layer_revision;
+    changed_rows.clear();
+    if (show_route)
+        solve_maze_route();
+}
 
-    // Reseting the file to the beginning
-    file.clear();
-    file.seekg(0);     
-    
-    // Loading the layers and maps    
-    std::vector<maze_element> layer_map;
-    maze_element map_element;
-    int matrix_map[100][100];
-    int i_index, j_index;
-    int type;
-    char init;
-    total_collectables = 0;
-    // std::cout << "\n- Layers -" << std::endl;
-    for (int layer = 0; layer < number_of_layers; ++layer) {
-        // std::cout << "\nLayer " << layer << " maze:" << std::endl;
-        for (int row = 0; row < rows_per_layer; ++row) {
-            getline(file, line);
-            std::stringstream string_stream(line);  
-            
-            // Reading the columns of a row
-            int column = 0;                       
-            while (string_stream >> item) {                
-                if (std::stringstream(item) >> type) {
-                    map_element.position = glm::vec3((float)(0 + column), 0.0f, (float)(0 + row));
-                    map_element.type = type;
-                    layer_map.push_back(map_element);
-                    matrix_map[row][column] = type;   
-                    if (type == 4)
-                        total_collectables += 1;                 
-                    // std::cout << type << " ";
-                }
-                    
-                else if (std::stringstream(item) >> init) {
-                    map_element.position = glm::vec3((float)(0 + column), 0.0f, (float)(0 + row));
-                    map_element.type = -1;
-                    layer_map.push_back(map_element);
-                    matrix_map[row][column] = -1;                    
-                    // std::cout << init << " ";
-                }                     
-                ++column;          
-            }            
-            // std::cout << "\n";
-        }        
-        
-        // Defining the walls
-        int index = 0;
-        for (int i = 0; i < rows_per_layer; ++i) {
-            for (int j = 0; j < columns; ++j) {
-                if (matrix_map[i][j] == -1 || matrix_map[i][j] == 0 || matrix_map[i][j] == 2 || matrix_map[i][j] == 3 || matrix_map[i][j] == 4) {
-                    if (j - 1 < 0) 
-                        layer_map[index].walls[0] = 1;
-                    else if (matrix_map[i][j - 1] == 1) 
-                        layer_map[index].walls[0] = 1;
-                    else
-                        layer_map[index].walls[0] = 0;
-
-                    if (j + 1 >= columns)
-                        layer_map[index].walls[1] = 1;
-                    else if (matrix_map[i][j + 1] == 1) 
-                        layer_map[index].walls[1] = 1;
-                    else
-                        layer_map[index].walls[1] = 0;
-
-                    if (i - 1 < 0) 
-                        layer_map[index].walls[2] = 1;
-                    if (matrix_map[i - 1][j] == 1) 
-                        layer_map[index].walls[2] = 1;
-                    else
-                        layer_map[index].walls[2] = 0;  
-
-                    if (i + 1 >= rows_per_layer)
-                        layer_map[index].walls[3] = 1;                    
-                    else if (matrix_map[i + 1][j] == 1) 
-                        layer_map[index].walls[3] = 1;
-                    else
-                        layer_map[index].walls[3] = 0;                
-                } 
-
-                else {
-                    layer_map[index].walls[0] = 1;
-                    layer_map[index].walls[1] = 1;
-                    layer_map[index].walls[2] = 1;
-                    layer_map[index].walls[3] = 1;
-                }
-                ++index;
-            }
-        }
 
-        // Cleaning the map
-        layers[layer] = layer_map;
-        layer_map.clear();   
-
-        // std::cout << std::endl;
-    }    
-
-    // Setting up the initial position in the maze
-    current_layer = 0;  
-    int index = 0;
-    for (int i = 0; i < rows_per_layer; ++i) {
-        for (int j = 0; j < rows_per_layer; ++j) {
-            layer_matrix[i][j] = layers[current_layer][index];  // Reading the first layer in a matrix format
-            if (layers[current_layer][index].type == -1) {
-                current_element = layers[current_layer][index];
-                current_element_position.first = j;
-                current_element_position.second = i;
-                initial_element_position.first = j;
-                initial_element_position.second = i;
-                camera_pos = 100.f * current_element.position;         
-            }   
-            ++index;          
-        }
-    }       
-    collectables = 0; // Number of items that have already been collected   
-   
-    // Printing the first layer with all attributes
-    std::vector<maze_element> layer_0 = layers[2];
-    // std::cout << "- First Layer -" << std::endl;    
-    for (int i = 0; i < layer_0.size(); ++i) {    
-        if (i % columns == 0) {
-            // std::cout << "\nRow " << i / 8 << ":" << std::endl;   
-        }    
-        struct maze_element element = layer_0[i];                     
-        // std::cout << element.type << " (" << element.position.x << " " << element.position.y <<  " " << element.position.z << ") " "(" << element.walls[0] << " " << element.walls[1] <<  " " << element.walls[2] << " " << element.walls[3] << ")"  << std::endl;        
+// Rows first to last of a layer changed in place: the snapshots copy them again if the player is on that layer
+void mark_rows_changed(int layer, int first, int last) {
+    ++maze_revision;
+    if (layer != player.layer)
+        return;
+    // A long list is not worth walking, the whole layer is copied instead
+    if (changed_rows.size() > (std::size_t)current_layer.height) {
+        ++layer_revision;
+        changed_rows.clear();
+        return;
     }
+    for (int row = std::max(first, 0); row <= std::min(last, current_layer.height - 1); ++row)
+        changed_rows.push_back(std::make_pair(maze_revision, row));
+}
+
+
+// Opening or closing a room at runtime (a door, a gate, E key), see edit_room. The rooms the player's collider
+// overlaps stay walkable, the route is solved again when it is shown
+bool edit_maze_room(int layer, int column, int row, int type) {
+    bool overlapped = column >= room_index(player.position.x - PLAYER_RADIUS) && column <= room_index(player.position.x + PLAYER_RADIUS) &&
+                      row >= room_index(player.position.z - PLAYER_RADIUS) && row <= room_index(player.position.z + PLAYER_RADIUS);
+    if (type == 1 && layer == player.layer && overlapped)
+        return false;
+    room_edit edit;
+    if (!edit_room(maze, layer, column, row, type, &edit))
+        return false;
+    if (edit.previous_type == edit.type)
+        return true;
+    mark_rows_changed(layer, row - 1, row + 1);
+    route_worker_edited(router, edit);
+    crowd_maze_edited(crowd);
+    if (show_route)
+        solve_maze_route();
+    return true;
+}
+
+
+// Asking for the route from the player's room through the items left and back to the start. The tick only posts
+// the request, the route worker solves it on its own thread (the route shown is cleared until it answers)
+void solve_maze_route() {
+    maze_cell from = {player.layer, player.element_position.first, player.element_position.second};
+    route_wanted = request_route(router, maze, from);
+    route_solving = true;
+    route.length = -1;
+    route.cells.clear();
+    route_rooms.clear();
+}
+
+
+// Taking the newest route solved by the worker when it answers the last request. Returns whether it was taken
+bool take_maze_route() {
+    if (!router.results.update() || router.results.read_buffer().request != route_wanted || !route_solving)
+        return false;
+    route = router.results.read_buffer().route;
+    route_solving = false;
+    route_rooms.clear();
+    for (std::size_t k = 0; k < route.cells.size(); ++k)
+        route_rooms.push_back(room_id(maze.grid, route.cells[k]));
+    std::sort(route_rooms.begin(), route_rooms.end());
+    return show_route;
 }
 
 
@@ -767,131 +824,174 @@ void bind_textures(unsigned int t_1, unsigned int t_2) {
 }
 
 
-// Checking if the player won the game
-void player_status() {
-    if (collectables == total_collectables && current_element_position == initial_element_position) {
-        std::cout << "\n- You Won! :P -" << std::endl;        
-        load_maze();
-        draw_maze_2d();
-        collectables = 0;
-    }
+// Sampling the keyboard (render thread) and handing it over to the simulation thread
+void sample_input(GLFWwindow *window) {
+    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+        glfwSetWindowShouldClose(window, true); 
+
+    input_state &input = input_buffer.write_buffer();
+    input.keys = 0;
+    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+        input.keys |= KEY_FORWARD;
+    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+        input.keys |= KEY_BACKWARD;
+    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+        input.keys |= KEY_LEFT;
+    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+        input.keys |= KEY_RIGHT;
+    if (glfwGetKey(window, GLFW_KEY_DELETE) == GLFW_PRESS)
+        input.keys |= KEY_RESTART;
+    if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS)
+        input.keys |= KEY_ROUTE;
+    if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
+        input.keys |= KEY_EDIT;
+    input.yaw = yaw;
+    input.pitch = pitch;
+    input_buffer.publish();
 }
 
 
-// Player movement using WSAD keys
-void process_input(GLFWwindow *window) {     
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-        glfwSetWindowShouldClose(window, true); 
+// Player movement using WSAD keys (simulation thread)
+void process_input(const input_state &input) {     
+    // Keys acting once per key press
+    int pressed = input.keys & ~previous_keys;
+    previous_keys = input.keys;
 
     // Restarts the game and all layers        
-    if (glfwGetKey(window, GLFW_KEY_DELETE) == GLFW_PRESS) {
+    if (pressed & KEY_RESTART) {
         std::cout << "\n- Maze Restarted! :) -" << std::endl;        
-        load_maze();
+        restart_maze();
         draw_maze_2d();
-        collectables = 0;        
-    }
-        
-    // Camera speed
-    const float camera_speed = 40.25f * delta_time;     
-    // Colision in Y-axis   
-    glm::vec3 camera_front_aux = glm::vec3((float)camera_front.x, 0.0f, (float)camera_front.z);          
-    // Colision in X-axis and Z-axis
-    if (current_element.walls[0] == 1 && camera_pos.x <= 100 * current_element_position.first - 49.) {
-        camera_pos = glm::vec3(camera_pos.x + 0.05, camera_pos.y, camera_pos.z);   
-        return;          
-    } 
-
-    if (current_element.walls[1] == 1 && camera_pos.x >= 100 * current_element_position.first + 49.) {
-        camera_pos = glm::vec3(camera_pos.x - 0.05, camera_pos.y, camera_pos.z);             
-        return;
     }
 
-    if (current_element.walls[2] == 1 && camera_pos.z <= 100 * current_element_position.second - 49.) {        
-        camera_pos = glm::vec3(camera_pos.x, camera_pos.y, camera_pos.z + 0.05);             
-        return;
+    // Shows or hides the route
+    if (pressed & KEY_ROUTE) {
+        show_route = !show_route;
+        if (show_route)
+            solve_maze_route();
+        draw_maze_2d();
     }
-    
-    if (current_element.walls[3] == 1 && camera_pos.z >= 100 * current_element_position.second + 49.) {
-        camera_pos = glm::vec3(camera_pos.x, camera_pos.y, camera_pos.z - 0.05);             
-        return;
-    }    
-
-    // When the player enter in another maze element
-    int draw_maze_2d_flag = 0;
-    if (current_element.walls[0] == 0 && camera_pos.x <= 100 * current_element_position.first - 49.8) {
-        current_element_position.first -= 1;   
-        current_element = layer_matrix[current_element_position.second][current_element_position.first];
-        draw_maze_2d_flag = 1;        
-    } 
-        
-    if (current_element.walls[1] == 0 && camera_pos.x >= 100 * current_element_position.first + 49.8) {
-        current_element_position.first += 1;      
-        current_element = layer_matrix[current_element_position.second][current_element_position.first];
-        draw_maze_2d_flag = 1;        
+
+    // Opens the wall room the player looks at (next to the player's room) or closes the empty one, like a door
+    if (pressed & KEY_EDIT) {
+        glm::vec3 front = camera_direction(input.yaw, 0.0f);
+        int column = player.element_position.first, row = player.element_position.second;
+        if (std::fabs(front.x) >= std::fabs(front.z))
+            column += front.x > 0.0f ? 1 : -1;
+        else
+            row += front.z > 0.0f ? 1 : -1;
+        int type = inside_grid(maze.grid, player.layer, column, row) ? cell_type(maze.grid, player.layer, column, row) : -1;
+        if ((type == 0 || type == 1) && edit_maze_room(player.layer, column, row, 1 - type))
+            draw_maze_2d();
     }
-        
-    if (current_element.walls[2] == 0 && camera_pos.z <= 100 * current_element_position.second - 49.8) {        
-        current_element_position.second -= 1;         
-        current_element = layer_matrix[current_element_position.second][current_element_position.first];   
-        draw_maze_2d_flag = 1;        
+
+    // Movement, collision, collectables and elevators
+    int events = step(maze, player, input, SIMULATION_STEP);
+    if (events & EVENT_LAYER_CHANGED) {
+        current_layer = view_layer(maze.grid, player.layer);
+        ++maze_revision;
+        ++layer_revision;
+        changed_rows.clear();
     }
-        
-    if (current_element.walls[3] == 0 && camera_pos.z >= 100 * current_element_position.second + 49.8) {
-        current_element_position.second += 1;             
-        current_element = layer_matrix[current_element_position.second][current_element_position.first];
-        draw_maze_2d_flag = 1;        
+    if (events & EVENT_COLLECTED)
+        mark_rows_changed(player.layer, player.element_position.second, player.element_position.second);
+    if (events & (EVENT_ROOM_CHANGED | EVENT_LAYER_CHANGED))
+        prefetch_ahead(maze, player, input);
+    if (show_route && (events & EVENT_COLLECTED) && !(events & EVENT_WON))
+        solve_maze_route();
+
+    // Route solved since the last request
+    if (take_maze_route())
+        draw_maze_2d();
+
+    // The other collectors (they leave the player's items in place)
+    step_crowd(crowd, SIMULATION_STEP);
+
+    // Checking if the player has collected all items and won the game
+    if (events & EVENT_WON) {
+        std::cout << "\n- You Won! :P -" << std::endl;        
+        restart_maze();
+        draw_maze_2d();
     }
-    
-    // When the player pick up a collectable item
-    if (current_element.type == 4) {            
-        if (camera_pos.x <= 100 * current_element_position.first + 5 && camera_pos.x >= 100 * current_element_position.first - 5 && camera_pos.z <= 100 * current_element_position.second + 5 && camera_pos.z >= 100 * current_element_position.second - 5)  {            
-            layers[current_layer][current_element_position.second * rows_per_layer + current_element_position.first].type = 0; // Transforming in an empty room
-            current_element = layers[current_layer][current_element_position.second * rows_per_layer + current_element_position.first];
-            collectables += 1;
-            draw_maze_2d_flag = 1;        
-        }
-    }   
+    else if (events)
+        draw_maze_2d();
+}
 
-    // When the player pass through an elevator
-    // Elevator to go up
-    if (current_element.type == 2)
-    {
-         if (camera_pos.x <= 100 * current_element_position.first + 5 && camera_pos.x >= 100 * current_element_position.first - 5 && camera_pos.z <= 100 * current_element_position.second + 5 && camera_pos.z >= 100 * current_element_position.second - 5)  {
-            current_layer = current_layer + 1;
-            current_element = layers[current_layer][current_element_position.second * rows_per_layer + current_element_position.first]; // The element in the top layer has the same coordinates as the current one                       
-            draw_maze_2d_flag = 1;                 
+
+// Game-state update at a fixed tick rate, running on its own thread
+void simulation_loop() {
+    double accumulator = 0.0;
+    double previous_time = steady_time();
+    glm::vec3 previous_camera_pos = player.position;
+
+    while (simulation_running) {
+        // Real time elapsed is accumulated and consumed in fixed steps, a long stall is not replayed in full
+        double current_time = steady_time();
+        accumulator += std::min(current_time - previous_time, (double)MAX_CATCH_UP_TIME);
+        previous_time = current_time;
+
+        // Newest input sampled by the render thread
+        input_buffer.update();
+        const input_state &input = input_buffer.read_buffer();
+
+        int steps = 0;
+        while (accumulator >= SIMULATION_STEP) {
+            previous_camera_pos = player.position;
+            process_input(input);
+
+            accumulator -= SIMULATION_STEP;
+            ++steps;
         }
+
+        if (steps > 0)
+            publish_snapshot(previous_camera_pos);
+
+        std::this_thread::sleep_for(std::chrono::duration<double>(SIMULATION_STEP - accumulator));
     }
+}
 
-    // Elevator to go down
-    if (current_element.type == 3) {
-         if (camera_pos.x <= 100 * current_element_position.first + 5 && camera_pos.x >= 100 * current_element_position.first - 5 && camera_pos.z <= 100 * current_element_position.second + 5 && camera_pos.z >= 100 * current_element_position.second - 5)  {
-            current_layer = current_layer - 1;
-            current_element = layers[current_layer][current_element_position.second * rows_per_layer + current_element_position.first]; // The element in the top layer has the same coordinates as the current one                   
-            draw_maze_2d_flag = 1;                 
-        }        
+
+// Copying the state the renderer needs into the next free snapshot slot.
+// The layer cells are only copied when they changed since this slot was last filled, and only the changed rows
+// when the slot holds the same layer
+void publish_snapshot(glm::vec3 previous_camera_pos) {
+    game_snapshot &snapshot = snapshot_buffer.write_buffer();
+    snapshot.previous_camera_pos = previous_camera_pos;
+    snapshot.camera_pos = player.position;
+    if (snapshot.revision != maze_revision && snapshot.layer_revision == layer_revision) {
+        for (std::size_t k = 0; k < changed_rows.size(); ++k) {
+            if (changed_rows[k].first <= snapshot.revision)
+                continue;
+            int row = changed_rows[k].second;
+            copy_layer_rows(current_layer, row, row + 1, snapshot.layer.data() + (std::size_t)row * current_layer.width);
+        }
+        snapshot.revision = maze_revision;
+    }
+    else if (snapshot.revision != maze_revision) {
+        snapshot.width = current_layer.width;
+        snapshot.height = current_layer.height;
+        snapshot.layer.resize((std::size_t)current_layer.width * current_layer.height);
+        copy_layer(current_layer, snapshot.layer.data());
+        snapshot.revision = maze_revision;
+        snapshot.layer_revision = layer_revision;
     }
+    snapshot.agents.clear();
+    crowd_instances(crowd, player.layer, snapshot.agents);
+    snapshot.tick_time = steady_time();
+    snapshot_buffer.publish();
+}
 
-    if (draw_maze_2d_flag)
-        draw_maze_2d();
 
-    // Player movement
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)                      
-        camera_pos += (float)(1.5 * camera_speed) * camera_front_aux;    
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-        camera_pos -= (float)(1.5 * camera_speed) * camera_front_aux;
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-        camera_pos -= glm::normalize(glm::cross(camera_front_aux, camera_up)) * camera_speed;
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-        camera_pos += glm::normalize(glm::cross(camera_front_aux, camera_up)) * camera_speed;        
-    
+// Seconds on a clock shared by the simulation and render threads
+double steady_time() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
 }
 
 
 // Update the player "vision" 
-void update_view_proj(Shader shader) {
+void update_view_proj(Shader shader, glm::vec3 view_pos) {
     // View
-    glm::mat4 view_matrix = glm::lookAt(camera_pos, camera_pos + camera_front, camera_up);
+    glm::mat4 view_matrix = glm::lookAt(view_pos, view_pos + camera_front, camera_up);
     shader.setMat4("view", view_matrix);
 
     // Projection     
@@ -932,11 +1032,7 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
     if(pitch < -89.0f)
         pitch = -89.0f;
 
-    glm::vec3 camera_direction;
-    camera_direction.x = cos(glm::radians(yaw)) * cos(glm::radians(pitch));
-    camera_direction.y = sin(glm::radians(pitch));
-    camera_direction.z = sin(glm::radians(yaw)) * cos(glm::radians(pitch));
-    camera_front = glm::normalize(camera_direction);
+    camera_front = camera_direction(yaw, pitch);
 }
 
 
@@ -0,0 +1,51 @@
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "../core/maze_loader.h"
+#include "../core/maze_batch.h"
+
+
+// Batch benchmark: N sessions with random inputs stepped in lockstep on every core
+int main(int argc, char *argv[]) {
+    const char *file_name = argc > 1 ? argv[1] : "input.txt";
+    int sessions = argc > 2 ? std::atoi(argv[2]) : 4096;
+    int steps = argc > 3 ? std::atoi(argv[3]) : 2000;
+
+    maze_model maze;
+    if (!load_maze(maze, file_name)) {
+        std::cout << "Failed to load the maze " << file_name << std::endl;
+        return -1;
+    }
+    ThreadPool pool;
+    maze_batch batch;
+    create_batch(batch, maze, sessions, &pool);
+
+    std::vector<int> keys(sessions), events(sessions);
+    std::vector<float> yaws(sessions), pitches(sessions, 0.0f);
+    std::vector<float> observations((std::size_t)sessions * OBSERVATION_SIZE);
+    std::mt19937 generator(42);
+    long long wins = 0;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < steps; ++i) {
+        // Random inputs, changed every half a second of simulated time
+        if (i % 60 == 0) {
+            for (int s = 0; s < sessions; ++s) {
+                keys[s] = generator() & (KEY_FORWARD | KEY_BACKWARD | KEY_LEFT | KEY_RIGHT);
+                yaws[s] = (float)(generator() % 360);
+            }
+        }
+        step_batch(batch, keys.data(), yaws.data(), pitches.data(), 1.0f / 120.0f, events.data());
+        observe_batch(batch, observations.data());
+        for (int s = 0; s < sessions; ++s)
+            wins += (events[s] & EVENT_WON) != 0;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double total = (double)sessions * steps;
+
+    std::cout << sessions << " sessions x " << steps << " steps on " << pool.size() << " threads in " << seconds << " s (" << total / seconds / 1e6 << " M env steps/s)" << std::endl;
+    std::cout << "Wins: " << wins << std::endl;
+    return 0;
+}
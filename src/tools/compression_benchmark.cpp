@@ -0,0 +1,115 @@
+#include <iostream>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+
+#include "../core/maze_loader.h"
+
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+// Random grid indices (uniform) and a random walk (one room to a neighbour), shared by every storage
+void access_patterns(const maze_grid &grid, int count, std::vector<std::size_t> &uniform, std::vector<std::size_t> &walk) {
+    unsigned int seed = 12345u;
+    uniform.resize(count);
+    walk.resize(count);
+    int layer = 0, column = grid.width / 2, row = grid.height / 2;
+    for (int k = 0; k < count; ++k) {
+        seed = seed * 1664525u + 1013904223u;
+        uniform[k] = (std::size_t)(seed >> 8) * 2654435761u % grid.cells.size();
+        int side = (seed >> 28) & 3;
+        column = std::min(std::max(column + (side == 0 ? -1 : (side == 1 ? 1 : 0)), 0), grid.width - 1);
+        row = std::min(std::max(row + (side == 2 ? -1 : (side == 3 ? 1 : 0)), 0), grid.height - 1);
+        walk[k] = grid_index(grid, layer, column, row);
+    }
+}
+
+
+// Reading the cells at the given indices, returns ns per access (sum keeps the reads alive)
+template <typename Reader>
+double access_time(const std::vector<std::size_t> &indices, Reader read, long long &sum) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (std::size_t k = 0; k < indices.size(); ++k)
+        sum += read(indices[k]);
+    return seconds_since(start) * 1e9 / indices.size();
+}
+
+
+// Compression ratio and access costs of run-length encoded storage against the plain grid
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cout << "Usage: compression_benchmark <maze> [memory budget in MB] [accesses]" << std::endl;
+        return -1;
+    }
+    std::size_t memory_budget = (std::size_t)(argc > 2 ? std::atoll(argv[2]) : 16) << 20;
+    int accesses = argc > 3 ? std::atoi(argv[3]) : 10000000;
+
+    maze_model maze;
+    if (!load_maze(maze, argv[1])) {
+        std::cout << "Failed to load the maze " << argv[1] << std::endl;
+        return -1;
+    }
+    maze_grid &plain = maze.grid;
+    maze_grid compressed = plain;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    compress_grid(compressed, memory_budget);
+    double encode_seconds = seconds_since(start);
+    const RunLengthRows &rows = *compressed.cells.paged()->run_lengths();
+
+    double plain_bytes = (double)plain.cells.size();
+    std::cout << plain.width << " x " << plain.height << " x " << plain.layers << " rooms, " << rows.runs() << " runs ("
+              << plain_bytes / rows.runs() << " rooms per run)" << std::endl;
+    std::cout << "Plain: " << plain_bytes / (1 << 20) << " MB, run-length: " << (double)rows.bytes() / (1 << 20) << " MB (ratio "
+              << plain_bytes / rows.bytes() << "), encoded in " << encode_seconds << " s" << std::endl;
+
+    // Random access: uniform (worst case) and a random walk (what the game does)
+    std::vector<std::size_t> uniform, walk;
+    access_patterns(plain, accesses, uniform, walk);
+    long long plain_sum = 0, encoded_sum = 0, paged_sum = 0;
+    const maze_grid &compressed_grid = compressed;
+    std::size_t width = plain.width;
+    const char *names[2] = {"Uniform access", "Random walk"};
+    const std::vector<std::size_t> *patterns[2] = {&uniform, &walk};
+    for (int p = 0; p < 2; ++p) {
+        double plain_ns = access_time(*patterns[p], [&](std::size_t i) { return plain.cells[i]; }, plain_sum);
+        double encoded_ns = access_time(*patterns[p], [&](std::size_t i) { return rows.get(i / width, (int)(i % width)); }, encoded_sum);
+        double paged_ns = access_time(*patterns[p], [&](std::size_t i) { return compressed_grid.cells[i]; }, paged_sum);
+        std::cout << names[p] << ": plain " << plain_ns << " ns, run-length search " << encoded_ns << " ns, decoded chunks " << paged_ns << " ns" << std::endl;
+    }
+
+    // Sequential scan of every layer in row-major order (as the renderer reads it)
+    std::vector<std::uint8_t> layer((std::size_t)plain.width * plain.height);
+    double scan_seconds[3] = {0.0, 0.0, 0.0};
+    for (int l = 0; l < plain.layers; ++l) {
+        start = std::chrono::steady_clock::now();
+        copy_layer(view_layer(plain, l), layer.data());
+        scan_seconds[0] += seconds_since(start);
+        for (std::size_t k = 0; k < layer.size(); k += 4093)
+            plain_sum += layer[k];
+
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < plain.height; ++i)
+            rows.decode((std::size_t)l * plain.height + i, 0, plain.width, layer.data() + (std::size_t)i * plain.width);
+        scan_seconds[1] += seconds_since(start);
+        for (std::size_t k = 0; k < layer.size(); k += 4093)
+            encoded_sum += layer[k];
+
+        start = std::chrono::steady_clock::now();
+        copy_layer(view_layer(compressed, l), layer.data());
+        scan_seconds[2] += seconds_since(start);
+        for (std::size_t k = 0; k < layer.size(); k += 4093)
+            paged_sum += layer[k];
+    }
+    double megabytes = plain_bytes / (1 << 20);
+    std::cout << "Sequential scan: plain " << megabytes / scan_seconds[0] << " MB/s, run-length decode " << megabytes / scan_seconds[1]
+              << " MB/s, decoded chunks " << megabytes / scan_seconds[2] << " MB/s" << std::endl;
+
+    if (plain_sum != encoded_sum || plain_sum != paged_sum) {
+        std::cout << "Storages disagree" << std::endl;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,55 @@
+#include <iostream>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+#include "../core/maze_loader.h"
+#include "../core/maze_crowd.h"
+
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+// Crowd benchmark: N agents competing for the items of a maze, stepped at 60 Hz of simulated time on every core.
+// Time per step (mean and worst) against the 16.7 ms of a 60 Hz frame, and what the agents did
+int main(int argc, char *argv[]) {
+    const char *file_name = argc > 1 ? argv[1] : "input.txt";
+    int agents = argc > 2 ? std::atoi(argv[2]) : 10000;
+    int steps = argc > 3 ? std::atoi(argv[3]) : 3600;
+    unsigned int threads = argc > 4 ? (unsigned int)std::atoi(argv[4]) : std::thread::hardware_concurrency();
+
+    maze_model maze;
+    if (!load_maze(maze, file_name)) {
+        std::cout << "Failed to load the maze " << file_name << std::endl;
+        return -1;
+    }
+    ThreadPool pool(std::max(threads, 1u));
+    maze_crowd crowd;
+    create_crowd(crowd, maze, agents, 7u, &pool);
+
+    const float dt = 1.0f / 60.0f;
+    double total_seconds = 0.0, worst = 0.0;
+    std::vector<float> instances;
+    for (int i = 0; i < steps; ++i) {
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        step_crowd(crowd, dt);
+        instances.clear();
+        crowd_instances(crowd, 0, instances);
+        double seconds = seconds_since(begin);
+        total_seconds += seconds;
+        worst = std::max(worst, seconds);
+    }
+    steps = std::max(steps, 1);
+
+    int walking = 0;
+    for (int a = 0; a < agents; ++a)
+        walking += crowd.target[a] >= 0;
+    std::cout << agents << " agents x " << steps << " steps on " << pool.size() << " threads: " << total_seconds * 1e3 / steps << " ms per step ("
+              << worst * 1e3 << " ms at most, a 60 Hz frame is 16.7 ms)" << std::endl;
+    std::cout << "Items claimed: " << crowd.claims << ", agents walking to an item: " << walking << ", agents on layer 0: " << instances.size() / 2 << std::endl;
+    return 0;
+}
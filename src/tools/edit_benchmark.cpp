@@ -0,0 +1,144 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+#include "../core/maze_loader.h"
+#include "../core/maze_edit.h"
+#include "../core/frontier_bfs.h"
+#include "../core/jump_point.h"
+#include "../core/cluster_graph.h"
+
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+// Random room that can be opened or closed (an empty room or a wall)
+maze_cell random_door(const maze_grid &grid, unsigned int &seed) {
+    for (;;) {
+        seed = seed * 1664525u + 1013904223u;
+        std::uint64_t id = ((std::uint64_t)seed << 16 ^ (seed >> 8)) % ((std::uint64_t)grid.width * grid.height * grid.layers);
+        maze_cell cell = room_cell(grid, id);
+        int type = cell_type(grid, cell.layer, cell.column, cell.row);
+        if (type == 0 || type == 1)
+            return cell;
+    }
+}
+
+
+// Updated and rebuilt block masks hold the same bits
+bool same_masks(const bit_search &a, const bit_search &b) {
+    if (a.masks.size() != b.masks.size())
+        return false;
+    for (std::size_t k = 0; k < a.masks.size(); ++k)
+        if (std::memcmp(&a.masks[k], &b.masks[k], sizeof(block_masks)) != 0)
+            return false;
+    return true;
+}
+
+// Updated and rebuilt graphs have the same nodes in every cluster and the same edges out of them (by room, the
+// updated one may number its nodes differently)
+bool same_graph(const cluster_graph &a, const cluster_graph &b) {
+    if (a.cluster_node_counts != b.cluster_node_counts)
+        return false;
+    std::vector<std::pair<std::uint64_t, std::uint32_t> > edges_a, edges_b;
+    for (std::size_t c = 0; c < a.cluster_node_counts.size(); ++c) {
+        for (std::uint32_t k = 0; k < a.cluster_node_counts[c]; ++k) {
+            std::uint32_t node_a = a.cluster_nodes[c] + k, node_b = b.cluster_nodes[c] + k;
+            if (a.node_rooms[node_a] != b.node_rooms[node_b])
+                return false;
+            edges_a.clear();
+            edges_b.clear();
+            for (std::uint64_t e = a.edge_offsets[node_a]; e < a.edge_offsets[node_a] + a.edge_counts[node_a]; ++e)
+                edges_a.push_back(std::make_pair(a.node_rooms[a.edge_targets[e]], a.edge_costs[e]));
+            for (std::uint64_t e = b.edge_offsets[node_b]; e < b.edge_offsets[node_b] + b.edge_counts[node_b]; ++e)
+                edges_b.push_back(std::make_pair(b.node_rooms[b.edge_targets[e]], b.edge_costs[e]));
+            std::sort(edges_a.begin(), edges_a.end());
+            std::sort(edges_b.begin(), edges_b.end());
+            if (edges_a != edges_b)
+                return false;
+        }
+    }
+    return true;
+}
+
+
+// Random doors opened and closed one at a time, the cached data updated after each edit and timed, then
+// compared with a full rebuild of the edited maze (the same data expected)
+int main(int argc, char *argv[]) {
+    const char *file_name = argc > 1 ? argv[1] : "input.txt";
+    int edits = argc > 2 ? std::atoi(argv[2]) : 100;
+    int cluster_size = argc > 3 ? std::max(std::atoi(argv[3]), 1) : CLUSTER_SIZE;
+    unsigned int threads = argc > 4 ? (unsigned int)std::atoi(argv[4]) : std::thread::hardware_concurrency();
+
+    maze_model maze;
+    if (!load_maze(maze, file_name)) {
+        std::cout << "Failed to load the maze " << file_name << std::endl;
+        return -1;
+    }
+    ThreadPool pool(std::max(threads, 1u));
+    bit_search search;
+    jump_table table;
+    cluster_graph graph;
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    derive_walls(maze.grid, &pool);
+    double walls_seconds = seconds_since(begin);
+    begin = std::chrono::steady_clock::now();
+    prepare_bit_search(search, maze, &pool);
+    double masks_seconds = seconds_since(begin);
+    begin = std::chrono::steady_clock::now();
+    build_jump_table(table, maze, &pool);
+    double table_seconds = seconds_since(begin);
+    begin = std::chrono::steady_clock::now();
+    build_cluster_graph(graph, maze, cluster_size, &pool);
+    double graph_seconds = seconds_since(begin);
+    std::cout << "Full build on " << pool.size() << " threads: walls " << walls_seconds * 1e3 << " ms, block masks " << masks_seconds * 1e3
+              << " ms, JPS+ table " << table_seconds * 1e3 << " ms, cluster graph " << graph_seconds * 1e3 << " ms" << std::endl;
+
+    unsigned int seed = 11u;
+    double edit_seconds = 0.0, block_seconds = 0.0, jump_seconds = 0.0, cluster_seconds = 0.0;
+    for (int e = 0; e < edits; ++e) {
+        maze_cell cell = random_door(maze.grid, seed);
+        int type = cell_type(maze.grid, cell.layer, cell.column, cell.row) == 1 ? 0 : 1;
+        begin = std::chrono::steady_clock::now();
+        edit_room(maze, cell.layer, cell.column, cell.row, type);
+        edit_seconds += seconds_since(begin);
+        begin = std::chrono::steady_clock::now();
+        update_block_masks(search, maze, cell.layer, cell.column, cell.row);
+        block_seconds += seconds_since(begin);
+        begin = std::chrono::steady_clock::now();
+        update_jump_table(table, maze, cell.layer, cell.column, cell.row);
+        jump_seconds += seconds_since(begin);
+        begin = std::chrono::steady_clock::now();
+        update_cluster_graph(graph, maze, cell.layer, cell.column, cell.row, &pool);
+        cluster_seconds += seconds_since(begin);
+    }
+    edits = std::max(edits, 1);
+    std::cout << edits << " edits, per edit: walls " << edit_seconds * 1e3 / edits << " ms, block masks " << block_seconds * 1e3 / edits
+              << " ms, JPS+ table " << jump_seconds * 1e3 / edits << " ms, cluster graph " << cluster_seconds * 1e3 / edits << " ms" << std::endl;
+
+    // The edited cells against walls derived from scratch, and the caches against a full rebuild
+    maze_model rebuilt;
+    rebuilt.grid = maze.grid;
+    derive_walls(rebuilt.grid, &pool);
+    bit_search rebuilt_search;
+    jump_table rebuilt_table;
+    cluster_graph rebuilt_graph;
+    prepare_bit_search(rebuilt_search, rebuilt, &pool);
+    build_jump_table(rebuilt_table, rebuilt, &pool);
+    build_cluster_graph(rebuilt_graph, rebuilt, cluster_size, &pool);
+    bool cells = true;
+    for (std::uint64_t id = 0; id < (std::uint64_t)maze.grid.width * maze.grid.height * maze.grid.layers; ++id)
+        cells = cells && room_byte(maze.grid, id) == room_byte(rebuilt.grid, id);
+    bool masks = same_masks(search, rebuilt_search);
+    bool jumps = table.distances == rebuilt_table.distances;
+    bool clusters = same_graph(graph, rebuilt_graph);
+    std::cout << "Against a full rebuild: walls " << (cells ? "same" : "DIFFERENT") << ", block masks " << (masks ? "same" : "DIFFERENT")
+              << ", JPS+ table " << (jumps ? "same" : "DIFFERENT") << ", cluster graph " << (clusters ? "same" : "DIFFERENT") << std::endl;
+    return cells && masks && jumps && clusters ? 0 : -1;
+}
@@ -0,0 +1,98 @@
+#include <iostream>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+#include "../core/maze_loader.h"
+#include "../core/cluster_graph.h"
+
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+// Random walkable room
+maze_cell random_room(const maze_grid &grid, unsigned int &seed) {
+    for (;;) {
+        seed = seed * 1664525u + 1013904223u;
+        std::uint64_t id = ((std::uint64_t)seed << 16 ^ (seed >> 8)) % ((std::uint64_t)grid.width * grid.height * grid.layers);
+        maze_cell cell = room_cell(grid, id);
+        if (walkable(grid, cell))
+            return cell;
+    }
+}
+
+
+// Checking that every step of a path is a legal move
+bool valid_path(const maze_grid &grid, const std::vector<maze_cell> &path) {
+    for (std::size_t k = 1; k < path.size(); ++k) {
+        std::uint64_t ids[6];
+        std::uint8_t moves[6];
+        int count = room_neighbours(grid, room_id(grid, path[k - 1]), ids, moves);
+        if (std::find(ids, ids + count, room_id(grid, path[k])) == ids + count)
+            return false;
+    }
+    return true;
+}
+
+
+// Cluster graph loaded from the cache next to the maze (or built and cached), then random route queries with A*
+// and HPA*: same reachability expected, HPA* routes refined and checked move by move, their extra length reported
+int main(int argc, char *argv[]) {
+    const char *file_name = argc > 1 ? argv[1] : "input.txt";
+    int queries = argc > 2 ? std::atoi(argv[2]) : 100;
+    int cluster_size = argc > 3 ? std::atoi(argv[3]) : CLUSTER_SIZE;
+    unsigned int threads = argc > 4 ? (unsigned int)std::atoi(argv[4]) : std::thread::hardware_concurrency();
+
+    maze_model maze;
+    if (!load_maze(maze, file_name)) {
+        std::cout << "Failed to load the maze " << file_name << std::endl;
+        return -1;
+    }
+    ThreadPool pool(std::max(threads, 1u));
+    cluster_graph graph;
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    bool loaded = cached_cluster_graph(graph, maze, file_name, std::max(cluster_size, 1), &pool);
+    double graph_seconds = seconds_since(begin);
+    std::cout << "Cluster graph (" << graph.cluster_size << "x" << graph.cluster_size << " clusters): " << graph.node_rooms.size() << " nodes, "
+              << graph.edge_targets.size() << " edges, " << (loaded ? "loaded from " : "built on ") << (loaded ? cluster_graph_file(file_name) : std::to_string(pool.size()) + " threads")
+              << " in " << graph_seconds * 1e3 << " ms" << std::endl;
+
+    path_search search;
+    prepare_search(search, maze);
+    hpa_query query;
+    unsigned int seed = 7u;
+    double astar_seconds = 0.0, hpa_seconds = 0.0, refine_seconds = 0.0, extra = 0.0, worst = 0.0;
+    int found = 0;
+    std::vector<maze_cell> cells;
+    for (int q = 0; q < queries; ++q) {
+        maze_cell from = random_room(maze.grid, seed), to = random_room(maze.grid, seed);
+        begin = std::chrono::steady_clock::now();
+        long long astar_length = astar_search(maze, search, from, to, nullptr);
+        astar_seconds += seconds_since(begin);
+        begin = std::chrono::steady_clock::now();
+        hpa_path path = hpa_search(graph, maze, query, from, to);
+        hpa_seconds += seconds_since(begin);
+        begin = std::chrono::steady_clock::now();
+        bool refined = refine_path(graph, maze, query.local, path, cells);
+        refine_seconds += seconds_since(begin);
+
+        if ((astar_length < 0) != (path.length < 0) || (path.length >= 0 && (!refined || !valid_path(maze.grid, cells) || (long long)cells.size() != path.length + 1))) {
+            std::cout << "Searches disagree: A* " << astar_length << ", HPA* " << path.length << std::endl;
+            return -1;
+        }
+        if (astar_length > 0) {
+            double ratio = (double)path.length / astar_length - 1.0;
+            extra += ratio;
+            worst = std::max(worst, ratio);
+        }
+        found += astar_length >= 0;
+    }
+    std::cout << queries << " queries (" << found << " reachable): A* " << astar_seconds * 1e3 / queries << " ms, HPA* " << hpa_seconds * 1e3 / queries
+              << " ms + " << refine_seconds * 1e3 / queries << " ms refining per query; HPA* routes " << (found ? extra * 100.0 / found : 0.0)
+              << "% longer on average (" << worst * 100.0 << "% at most)" << std::endl;
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include <iostream>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+#include "../core/maze_loader.h"
+#include "../core/jump_point.h"
+
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+// Random walkable room
+maze_cell random_room(const maze_grid &grid, unsigned int &seed) {
+    for (;;) {
+        seed = seed * 1664525u + 1013904223u;
+        std::uint64_t id = ((std::uint64_t)seed << 16 ^ (seed >> 8)) % ((std::uint64_t)grid.width * grid.height * grid.layers);
+        maze_cell cell = room_cell(grid, id);
+        if (walkable(grid, cell))
+            return cell;
+    }
+}
+
+
+// Checking that every step of a path is a legal move
+bool valid_path(const maze_grid &grid, const std::vector<maze_cell> &path) {
+    for (std::size_t k = 1; k < path.size(); ++k) {
+        std::uint64_t ids[6];
+        std::uint8_t moves[6];
+        int count = room_neighbours(grid, room_id(grid, path[k - 1]), ids, moves);
+        if (std::find(ids, ids + count, room_id(grid, path[k])) == ids + count)
+            return false;
+    }
+    return true;
+}
+
+
+// Random route queries with A*, JPS and JPS+ (same lengths expected, JPS paths checked move by move):
+// rooms or jump points expanded and time per query
+int main(int argc, char *argv[]) {
+    const char *file_name = argc > 1 ? argv[1] : "input.txt";
+    int queries = argc > 2 ? std::atoi(argv[2]) : 100;
+    unsigned int threads = argc > 3 ? (unsigned int)std::atoi(argv[3]) : std::thread::hardware_concurrency();
+
+    maze_model maze;
+    if (!load_maze(maze, file_name)) {
+        std::cout << "Failed to load the maze " << file_name << std::endl;
+        return -1;
+    }
+    ThreadPool pool(std::max(threads, 1u));
+    jump_table table;
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    build_jump_table(table, maze, &pool);
+    std::cout << "JPS+ table: " << table.distances.size() * sizeof(std::int16_t) / (1 << 20) << " MB, built in " << seconds_since(begin) * 1e3
+              << " ms on " << pool.size() << " threads" << std::endl;
+
+    path_search search;
+    prepare_search(search, maze);
+    jump_search jumps;
+    prepare_jump_search(jumps, maze);
+    const char *names[3] = {"A*", "JPS", "JPS+"};
+    double seconds[3] = {0.0, 0.0, 0.0};
+    long long expanded[3] = {0, 0, 0};
+    unsigned int seed = 7u;
+    int found = 0;
+    std::vector<maze_cell> jps_path;
+    for (int q = 0; q < queries; ++q) {
+        maze_cell from = random_room(maze.grid, seed), to = random_room(maze.grid, seed);
+        long long lengths[3];
+        begin = std::chrono::steady_clock::now();
+        lengths[0] = astar_search(maze, search, from, to, nullptr, &expanded[0]);
+        seconds[0] += seconds_since(begin);
+        begin = std::chrono::steady_clock::now();
+        lengths[1] = jps_search(maze, jumps, from, to, &jps_path, nullptr, &expanded[1]);
+        seconds[1] += seconds_since(begin);
+        begin = std::chrono::steady_clock::now();
+        lengths[2] = jps_search(maze, jumps, from, to, nullptr, &table, &expanded[2]);
+        seconds[2] += seconds_since(begin);
+
+        if (lengths[1] != lengths[0] || lengths[2] != lengths[0] || (lengths[1] >= 0 && (!valid_path(maze.grid, jps_path) || (long long)jps_path.size() != lengths[1] + 1))) {
+            std::cout << "Searches disagree: A* " << lengths[0] << ", JPS " << lengths[1] << ", JPS+ " << lengths[2] << std::endl;
+            return -1;
+        }
+        found += lengths[0] >= 0;
+    }
+    std::cout << queries << " queries (" << found << " reachable), per query:" << std::endl;
+    for (int k = 0; k < 3; ++k)
+        std::cout << "  " << names[k] << ": " << seconds[k] * 1e3 / queries << " ms, " << expanded[k] / std::max(queries, 1) << " expanded" << std::endl;
+    return 0;
+}
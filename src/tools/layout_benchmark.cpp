@@ -0,0 +1,97 @@
+#include <iostream>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+
+#include "../core/maze_grid.h"
+
+
+// Random layers (about one room in five is a wall, the center is open), same rooms for every layout
+void random_grid(maze_grid &grid, int size, int layers, unsigned int seed) {
+    resize_grid(grid, size, size, layers);
+    for (std::size_t i = 0; i < grid.cells.size(); ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        grid.cells[i] = (seed >> 24) % 5 == 0 ? 1 : 0;
+    }
+    for (int l = 0; l < layers; ++l)
+        grid.cells[grid_index(grid, l, size / 2, size / 2)] = 0;
+    derive_walls(grid);
+}
+
+
+// Neighbourhood pass: every room reads the types of its four neighbours
+long long neighbour_pass(const maze_grid &grid) {
+    long long open = 0;
+    for (int l = 0; l < grid.layers; ++l)
+        for (int i = 1; i + 1 < grid.height; ++i)
+            for (int j = 1; j + 1 < grid.width; ++j)
+                open += (cell_type(grid, l, j - 1, i) != 1) + (cell_type(grid, l, j + 1, i) != 1) + (cell_type(grid, l, j, i - 1) != 1) + (cell_type(grid, l, j, i + 1) != 1);
+    return open;
+}
+
+
+// Flood fill (BFS) of the first layer through the open sides, from the center room
+long long flood_fill(const maze_grid &grid) {
+    std::vector<std::uint8_t> visited(grid.layer_size, 0);
+    std::vector<std::uint32_t> queue;
+    queue.reserve((std::size_t)grid.width * grid.height);
+    queue.push_back((std::uint32_t)(grid.height / 2) * grid.width + grid.width / 2);
+    visited[grid_index(grid, 0, grid.width / 2, grid.height / 2)] = 1;
+
+    const int step_column[4] = {-1, 1, 0, 0};
+    const int step_row[4] = {0, 0, -1, 1};
+    for (std::size_t head = 0; head < queue.size(); ++head) {
+        int column = queue[head] % grid.width, row = queue[head] / grid.width;
+        int walls = cell_walls(grid, 0, column, row);
+        for (int side = 0; side < 4; ++side) {
+            if (walls & (1 << side))
+                continue;
+            int c = column + step_column[side], r = row + step_row[side];
+            std::uint8_t &seen = visited[grid_index(grid, 0, c, r)];
+            if (!seen) {
+                seen = 1;
+                queue.push_back((std::uint32_t)r * grid.width + c);
+            }
+        }
+    }
+    return (long long)queue.size();
+}
+
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+// Comparing the row-major and tiled layouts on neighbourhood-heavy passes
+int main(int argc, char *argv[]) {
+    int size = argc > 1 ? std::atoi(argv[1]) : 4096;
+    int layers = argc > 2 ? std::atoi(argv[2]) : 1;
+    if (size < 3 || layers < 1) {
+        std::cout << "Usage: layout_benchmark [size] [layers]" << std::endl;
+        return -1;
+    }
+
+    maze_grid grid;
+    random_grid(grid, size, layers, 12345u);
+    double rooms = (double)size * size * layers;
+    std::cout << size << " x " << size << " x " << layers << " rooms" << std::endl;
+
+    const int layouts[3] = {LAYOUT_ROW_MAJOR, LAYOUT_TILES_8, LAYOUT_TILES_16};
+    const char *names[3] = {"row-major", "8x8 tiles", "16x16 tiles"};
+    for (int k = 0; k < 3; ++k) {
+        set_grid_layout(grid, layouts[k]);
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        long long open = neighbour_pass(grid);
+        double neighbour_seconds = seconds_since(start);
+
+        start = std::chrono::steady_clock::now();
+        long long reached = flood_fill(grid);
+        double flood_seconds = seconds_since(start);
+
+        std::cout << names[k] << ": neighbours " << neighbour_seconds * 1e9 / rooms << " ns/room (" << open << " open sides), flood fill "
+                  << flood_seconds * 1e9 / reached << " ns/room (" << reached << " rooms)" << std::endl;
+    }
+    return 0;
+}
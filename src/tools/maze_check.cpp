@@ -0,0 +1,50 @@
+#include <iostream>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+#include "../core/maze_loader.h"
+#include "../core/maze_connectivity.h"
+
+
+// Checking a maze file before playing it: collectables out of reach, elevators leading nowhere, components and
+// the diameter. The exit status is 1 when an item cannot be reached or an elevator is dead
+int main(int argc, char *argv[]) {
+    const char *file_name = argc > 1 ? argv[1] : "input.txt";
+    unsigned int threads = argc > 2 ? (unsigned int)std::atoi(argv[2]) : std::thread::hardware_concurrency();
+    const std::size_t listed = 20;     // Rooms listed at most per problem
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    maze_model maze;
+    if (!load_maze(maze, file_name)) {
+        std::cout << "Failed to load the maze " << file_name << std::endl;
+        return -1;
+    }
+    double load_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    ThreadPool pool(std::max(threads, 1u));
+    maze_connectivity report;
+    start = std::chrono::steady_clock::now();
+    analyze_connectivity(maze, report, &pool);
+    double check_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << maze.grid.width << " x " << maze.grid.height << " x " << maze.grid.layers << " rooms, loaded in " << load_seconds << " s, checked in "
+              << check_seconds << " s on " << pool.size() << " threads" << std::endl;
+    std::cout << report.walkable_rooms << " walkable rooms in " << report.components << " components (largest " << report.largest_component
+              << ", start room's " << report.start_component << "), " << report.reachable_rooms << " reachable from the start room" << std::endl;
+    std::cout << "Diameter: at least " << report.diameter << " moves, from (" << report.diameter_ends[0].layer << ", " << report.diameter_ends[0].column << ", "
+              << report.diameter_ends[0].row << ") to (" << report.diameter_ends[1].layer << ", " << report.diameter_ends[1].column << ", " << report.diameter_ends[1].row << ")" << std::endl;
+
+    std::cout << "Unreachable collectables: " << report.unreachable_collectables.size() << "/" << maze.collectable_cells.size() << std::endl;
+    for (std::size_t k = 0; k < std::min(report.unreachable_collectables.size(), listed); ++k)
+        std::cout << "    layer " << report.unreachable_collectables[k].layer << ", column " << report.unreachable_collectables[k].column << ", row "
+                  << report.unreachable_collectables[k].row << std::endl;
+    std::cout << "Dead elevators: " << report.dead_elevators.size() << std::endl;
+    for (std::size_t k = 0; k < std::min(report.dead_elevators.size(), listed); ++k) {
+        const maze_cell &cell = report.dead_elevators[k];
+        std::cout << "    layer " << cell.layer << ", column " << cell.column << ", row " << cell.row << " ("
+                  << (cell_type(maze.grid, cell.layer, cell.column, cell.row) == 2 ? "up" : "down") << ")" << std::endl;
+    }
+    return report.unreachable_collectables.empty() && report.dead_elevators.empty() ? 0 : 1;
+}
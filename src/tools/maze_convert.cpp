@@ -0,0 +1,47 @@
+#include <iostream>
+#include <cstring>
+#include <chrono>
+
+#include "../core/maze_loader.h"
+
+
+// Converting a maze (text or binary) into the binary format
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        std::cout << "Usage: maze_convert <input> <output.bin> [--no-walls] [--no-index]" << std::endl;
+        return -1;
+    }
+    std::uint32_t flags = BINARY_WALLS | BINARY_COLLECTABLES;
+    for (int i = 3; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--no-walls") == 0)
+            flags &= ~BINARY_WALLS;
+        else if (std::strcmp(argv[i], "--no-index") == 0)
+            flags &= ~BINARY_COLLECTABLES;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    maze_model maze;
+    if (!load_maze(maze, argv[1])) {
+        std::cout << "Failed to load the maze " << argv[1] << std::endl;
+        return -1;
+    }
+    double load_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (!save_maze_binary(maze, argv[2], flags)) {
+        std::cout << "Failed to write " << argv[2] << std::endl;
+        return -1;
+    }
+
+    // Loading it back, as the game would
+    start = std::chrono::steady_clock::now();
+    maze_model loaded;
+    if (!load_maze(loaded, argv[2])) {
+        std::cout << "Failed to read back " << argv[2] << std::endl;
+        return -1;
+    }
+    double binary_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << maze.grid.width << " x " << maze.grid.height << " x " << maze.grid.layers << " rooms, " << maze.total_collectables << " collectables" << std::endl;
+    std::cout << "Input loaded in " << load_seconds << " s, binary loaded in " << binary_seconds << " s" << std::endl;
+    return 0;
+}
@@ -0,0 +1,53 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+#include "../core/maze_generator.h"
+
+
+// Generating a maze file: grid size, floors and options on the command line
+int main(int argc, char *argv[]) {
+    if (argc < 5) {
+        std::cout << "Usage: maze_generator <output> <width> <height> <layers> [--binary] [--braid share] [--elevators share] [--items count] [--seed n] [--threads n]" << std::endl;
+        return -1;
+    }
+    maze_generator_options options;
+    options.width = std::atoi(argv[2]);
+    options.height = std::atoi(argv[3]);
+    options.layers = std::atoi(argv[4]);
+    options.braid = 0.0;
+    options.elevators = 0.01;
+    options.collectables = 4;
+    options.seed = 1;
+    bool binary = false;
+    unsigned int threads = std::thread::hardware_concurrency();
+    for (int i = 5; i < argc; ++i) {
+        bool value = i + 1 < argc;
+        if (std::strcmp(argv[i], "--binary") == 0)
+            binary = true;
+        else if (std::strcmp(argv[i], "--braid") == 0 && value)
+            options.braid = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--elevators") == 0 && value)
+            options.elevators = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--items") == 0 && value)
+            options.collectables = std::atoll(argv[++i]);
+        else if (std::strcmp(argv[i], "--seed") == 0 && value)
+            options.seed = std::strtoull(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--threads") == 0 && value)
+            threads = (unsigned int)std::atoi(argv[++i]);
+    }
+
+    ThreadPool pool(std::max(threads, 1u));
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (!write_generated_maze(options, argv[1], binary, &pool)) {
+        std::cout << "Failed to write " << argv[1] << std::endl;
+        return -1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << options.width << " x " << options.height << " x " << options.layers << " rooms written to " << argv[1] << " (" << (binary ? "binary" : "text")
+              << ") in " << seconds << " s on " << pool.size() << " threads" << std::endl;
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <functional>
+
+#include "../core/maze_loader.h"
+
+
+// Timing a loader over a few runs, returns the best time in seconds
+double best_time(const std::function<bool(maze_model&)> &load, maze_model &maze, int runs) {
+    double best = -1.0;
+    for (int r = 0; r < runs; ++r) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (!load(maze))
+            return -1.0;
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (best < 0.0 || seconds < best)
+            best = seconds;
+    }
+    return best;
+}
+
+
+bool same_maze(const maze_model &a, const maze_model &b) {
+    return a.grid.width == b.grid.width && a.grid.height == b.grid.height && a.grid.layers == b.grid.layers
+        && a.grid.cells.size() == b.grid.cells.size() && std::memcmp(a.grid.cells.data(), b.grid.cells.data(), a.grid.cells.size()) == 0
+        && a.initial_element_position == b.initial_element_position && a.collectable_cells == b.collectable_cells;
+}
+
+
+// Comparing the streaming text loader with the parallel parser (single thread and every thread)
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cout << "Usage: parser_benchmark <maze.txt> [threads] [runs]" << std::endl;
+        return -1;
+    }
+    const char *file_name = argv[1];
+    int threads = argc > 2 ? std::atoi(argv[2]) : 0;
+    int runs = argc > 3 ? std::atoi(argv[3]) : 3;
+
+    MappedFile file;
+    if (!file.open(file_name)) {
+        std::cout << "Failed to open " << file_name << std::endl;
+        return -1;
+    }
+    double megabytes = file.size() / (1024.0 * 1024.0);
+    file.close();
+
+    ThreadPool pool(threads);
+    maze_model streamed, serial, parallel;
+    double streamed_seconds = best_time([&](maze_model &maze) { return load_maze_text(maze, file_name); }, streamed, runs);
+    double serial_seconds = best_time([&](maze_model &maze) { return load_maze_text_parallel(maze, file_name, nullptr); }, serial, runs);
+    double parallel_seconds = best_time([&](maze_model &maze) { return load_maze_text_parallel(maze, file_name, &pool); }, parallel, runs);
+    if (streamed_seconds < 0.0 || serial_seconds < 0.0 || parallel_seconds < 0.0) {
+        std::cout << "Failed to load the maze " << file_name << std::endl;
+        return -1;
+    }
+    if (!same_maze(streamed, serial) || !same_maze(streamed, parallel)) {
+        std::cout << "Parsers disagree on " << file_name << std::endl;
+        return -1;
+    }
+
+    std::cout << streamed.grid.width << " x " << streamed.grid.height << " x " << streamed.grid.layers << " rooms, " << megabytes << " MB" << std::endl;
+    std::cout << "Streaming loader: " << streamed_seconds << " s, " << megabytes / streamed_seconds << " MB/s" << std::endl;
+    std::cout << "Parallel parser (1 thread): " << serial_seconds << " s, " << megabytes / serial_seconds << " MB/s" << std::endl;
+    std::cout << "Parallel parser (" << pool.size() << " threads): " << parallel_seconds << " s, " << megabytes / parallel_seconds << " MB/s" << std::endl;
+    return 0;
+}
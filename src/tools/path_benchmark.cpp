@@ -0,0 +1,113 @@
+#include <iostream>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+#include "../core/maze_loader.h"
+#include "../core/frontier_bfs.h"
+
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+// Random walkable room
+maze_cell random_room(const maze_grid &grid, unsigned int &seed) {
+    for (;;) {
+        seed = seed * 1664525u + 1013904223u;
+        std::uint64_t id = ((std::uint64_t)seed << 16 ^ (seed >> 8)) % ((std::uint64_t)grid.width * grid.height * grid.layers);
+        maze_cell cell = room_cell(grid, id);
+        if (walkable(grid, cell))
+            return cell;
+    }
+}
+
+
+// Checking that every step of a path is a legal move
+bool valid_path(const maze_grid &grid, const std::vector<maze_cell> &path) {
+    for (std::size_t k = 1; k < path.size(); ++k) {
+        std::uint64_t ids[6];
+        std::uint8_t moves[6];
+        int count = room_neighbours(grid, room_id(grid, path[k - 1]), ids, moves);
+        bool found = false;
+        for (int n = 0; n < count; ++n)
+            found |= ids[n] == room_id(grid, path[k]);
+        if (!found)
+            return false;
+    }
+    return true;
+}
+
+
+// Random route queries with BFS and A* (same lengths expected), and a full distance field from the start room
+// with the queue BFS and the bitmask BFS (same distances expected)
+int main(int argc, char *argv[]) {
+    const char *file_name = argc > 1 ? argv[1] : "input.txt";
+    int queries = argc > 2 ? std::atoi(argv[2]) : 100;
+    unsigned int threads = argc > 3 ? (unsigned int)std::atoi(argv[3]) : std::thread::hardware_concurrency();
+
+    maze_model maze;
+    if (!load_maze(maze, file_name)) {
+        std::cout << "Failed to load the maze " << file_name << std::endl;
+        return -1;
+    }
+    path_search search;
+    prepare_search(search, maze);
+
+    // Best of a few runs (the first one also pays for the page faults of the distance arrays)
+    const int runs = 3;
+    maze_cell start = {0, maze.initial_element_position.first, maze.initial_element_position.second};
+    std::vector<int> distances;
+    long long reached = 0;
+    double queue_seconds = 1e30;
+    for (int run = 0; run < runs; ++run) {
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        reached = bfs_search(maze, search, start, nullptr, &distances, nullptr);
+        queue_seconds = std::min(queue_seconds, seconds_since(begin));
+    }
+
+    ThreadPool pool(std::max(threads, 1u));
+    bit_search bits;
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    prepare_bit_search(bits, maze, &pool);
+    double masks_seconds = seconds_since(begin);
+    std::vector<int> bit_distances;
+    long long bit_reached = 0;
+    double bit_seconds = 1e30;
+    for (int run = 0; run < runs; ++run) {
+        begin = std::chrono::steady_clock::now();
+        bit_reached = bit_bfs(bits, maze, start, &bit_distances, &pool);
+        bit_seconds = std::min(bit_seconds, seconds_since(begin));
+    }
+    if (bit_reached != reached || bit_distances != distances) {
+        std::cout << "Distance fields disagree: " << reached << " rooms reached by the queue BFS, " << bit_reached << " by the bitmask BFS" << std::endl;
+        return -1;
+    }
+    std::cout << "Distance field from the start: " << reached << " rooms reached, queue BFS " << queue_seconds * 1e3 << " ms, bitmask BFS "
+              << bit_seconds * 1e3 << " ms on " << pool.size() << " threads (block masks built in " << masks_seconds * 1e3 << " ms)" << std::endl;
+
+    unsigned int seed = 7u;
+    double bfs_seconds = 0.0, astar_seconds = 0.0;
+    int found = 0;
+    std::vector<maze_cell> bfs_path, astar_path;
+    for (int q = 0; q < queries; ++q) {
+        maze_cell from = random_room(maze.grid, seed), to = random_room(maze.grid, seed);
+        begin = std::chrono::steady_clock::now();
+        long long bfs_length = bfs_search(maze, search, from, &to, nullptr, &bfs_path);
+        bfs_seconds += seconds_since(begin);
+        begin = std::chrono::steady_clock::now();
+        long long astar_length = astar_search(maze, search, from, to, &astar_path);
+        astar_seconds += seconds_since(begin);
+
+        if (bfs_length != astar_length || (astar_length >= 0 && (!valid_path(maze.grid, astar_path) || (long long)astar_path.size() != astar_length + 1))) {
+            std::cout << "Searches disagree: BFS " << bfs_length << ", A* " << astar_length << std::endl;
+            return -1;
+        }
+        found += astar_length >= 0;
+    }
+    std::cout << queries << " queries (" << found << " reachable): BFS " << bfs_seconds * 1e3 / queries << " ms, A* " << astar_seconds * 1e3 / queries << " ms per query" << std::endl;
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include <iostream>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+#include "../core/maze_loader.h"
+#include "../core/path_repair.h"
+
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+unsigned int next_random(unsigned int &seed) {
+    seed = seed * 1664525u + 1013904223u;
+    return seed >> 8;
+}
+
+// Random walkable room
+maze_cell random_room(const maze_grid &grid, unsigned int &seed) {
+    for (;;) {
+        std::uint64_t id = ((std::uint64_t)next_random(seed) << 24 ^ next_random(seed)) % ((std::uint64_t)grid.width * grid.height * grid.layers);
+        maze_cell cell = room_cell(grid, id);
+        if (walkable(grid, cell))
+            return cell;
+    }
+}
+
+
+// An agent walks to random goals while doors open and close (half of the doors closed on its route ahead),
+// the route is repaired after every edit and checked against a full A* replan from the agent's room:
+// time and rooms settled per repair against the replan
+int main(int argc, char *argv[]) {
+    const char *file_name = argc > 1 ? argv[1] : "input.txt";
+    int edits = argc > 2 ? std::atoi(argv[2]) : 1000;
+
+    maze_model maze;
+    if (!load_maze(maze, file_name)) {
+        std::cout << "Failed to load the maze " << file_name << std::endl;
+        return -1;
+    }
+    repair_planner planner;
+    prepare_repair(planner, maze);
+    path_search search;
+    prepare_search(search, maze);
+
+    unsigned int seed = 5u;
+    double plan_seconds = 0.0, repair_seconds = 0.0, astar_seconds = 0.0, worst_repair = 0.0;
+    long long settled = 0, expanded = 0, length = -1;
+    int plans = 0;
+    maze_cell agent = random_room(maze.grid, seed), goal = agent;
+    std::vector<maze_cell> path;
+    for (int e = 0; e < edits; ++e) {
+        // A new goal when the agent got there, the agent is moved too when walled in
+        for (int attempt = 0; length <= 0; ++attempt) {
+            if (attempt == 1000) {
+                std::cout << "No route left to plan after edit " << e << std::endl;
+                return -1;
+            }
+            if (attempt > 0 && length < 0)
+                agent = random_room(maze.grid, seed);
+            goal = random_room(maze.grid, seed);
+            std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+            length = plan_repair_route(planner, maze, agent, goal);
+            plan_seconds += seconds_since(begin);
+            ++plans;
+        }
+        repair_path(planner, maze, path);
+        agent = path[1];
+        move_repair_start(planner, maze, agent);
+
+        // Every other edit closes a room (on the route ahead when it is long enough) or opens a wall room, never the
+        // agent's room or the goal
+        room_edit edit;
+        for (;;) {
+            maze_cell cell = room_cell(maze.grid, ((std::uint64_t)next_random(seed) << 24 ^ next_random(seed)) % planner.rooms);
+            if (e % 2 == 0 && path.size() > 3 && next_random(seed) % 2)
+                cell = path[2 + next_random(seed) % (path.size() - 3)];
+            if (room_id(maze.grid, cell) == room_id(maze.grid, agent) || room_id(maze.grid, cell) == planner.goal)
+                continue;
+            int type = e % 2 == 0 ? 1 : 0;
+            if (cell_type(maze.grid, cell.layer, cell.column, cell.row) == 1 - type && edit_room(maze, cell.layer, cell.column, cell.row, type, &edit))
+                break;
+        }
+
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        length = repair_route(planner, maze, &edit, 1);
+        double seconds = seconds_since(begin);
+        repair_seconds += seconds;
+        worst_repair = std::max(worst_repair, seconds);
+        settled += planner.expanded;
+
+        begin = std::chrono::steady_clock::now();
+        long long replanned = astar_search(maze, search, agent, goal, nullptr, &expanded);
+        astar_seconds += seconds_since(begin);
+        if (replanned != length || (length >= 0 && repair_path(planner, maze, path) != length)) {
+            std::cout << "Repair and replan disagree after edit " << e << ": D* Lite " << length << ", A* " << replanned << std::endl;
+            return -1;
+        }
+    }
+    edits = std::max(edits, 1);
+    std::cout << edits << " edits, " << plans << " routes planned (" << plan_seconds * 1e3 / plans << " ms each)" << std::endl;
+    std::cout << "Repair: " << repair_seconds * 1e3 / edits << " ms (" << worst_repair * 1e3 << " ms at most), " << (double)settled / edits
+              << " rooms settled per edit" << std::endl;
+    std::cout << "A* replan: " << astar_seconds * 1e3 / edits << " ms, " << (double)expanded / edits << " rooms expanded per edit" << std::endl;
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+#include "../core/maze_loader.h"
+#include "../core/route_solver.h"
+
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+// Checking a route the way the game would play it: legal moves only, every item on the way, ending on the start room
+bool valid_route(const maze_model &maze, const maze_route &route) {
+    const maze_grid &grid = maze.grid;
+    std::vector<std::uint64_t> rooms;
+    for (std::size_t k = 0; k < route.cells.size(); ++k) {
+        rooms.push_back(room_id(grid, route.cells[k]));
+        if (k == 0)
+            continue;
+        std::uint64_t ids[6];
+        std::uint8_t moves[6];
+        int count = room_neighbours(grid, rooms[k - 1], ids, moves);
+        if (std::find(ids, ids + count, rooms[k]) == ids + count)
+            return false;
+    }
+    std::sort(rooms.begin(), rooms.end());
+    std::vector<int> items = remaining_collectables(maze);
+    for (std::size_t k = 0; k < items.size(); ++k) {
+        maze_cell item;
+        index_position(grid, maze.collectable_cells[items[k]], item.layer, item.column, item.row);
+        if (!std::binary_search(rooms.begin(), rooms.end(), room_id(grid, item)))
+            return false;
+    }
+    const maze_cell &end = route.cells.back();
+    return (long long)route.cells.size() == route.length + 1 && end.layer == 0 && end.column == maze.initial_element_position.first && end.row == maze.initial_element_position.second;
+}
+
+
+// Level validation: the shortest route that collects every item and returns to the start, from the start room.
+// Exits with an error when an item cannot be collected or the route does not win
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cout << "Usage: route_solver <maze> [time budget in seconds] [threads] [--path route.txt]" << std::endl;
+        return -1;
+    }
+    double time_budget = argc > 2 && argv[2][0] != '-' ? std::atof(argv[2]) : 5.0;
+    unsigned int threads = argc > 3 && argv[3][0] != '-' ? (unsigned int)std::atoi(argv[3]) : std::thread::hardware_concurrency();
+    const char *path_file = nullptr;
+    for (int i = 2; i + 1 < argc; ++i)
+        if (std::strcmp(argv[i], "--path") == 0)
+            path_file = argv[i + 1];
+
+    maze_model maze;
+    if (!load_maze(maze, argv[1])) {
+        std::cout << "Failed to load the maze " << argv[1] << std::endl;
+        return -1;
+    }
+    ThreadPool pool(std::max(threads, 1u));
+    maze_cell start = {0, maze.initial_element_position.first, maze.initial_element_position.second};
+
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    maze_route route = solve_route(maze, start, &pool, time_budget);
+    double solve_seconds = seconds_since(begin);
+
+    std::cout << maze.grid.width << " x " << maze.grid.height << " x " << maze.grid.layers << " rooms, " << maze.total_collectables << " collectables" << std::endl;
+    if (!route.unreachable.empty()) {
+        std::cout << route.unreachable.size() << " collectables cannot be collected (and the start reached again):";
+        for (std::size_t k = 0; k < route.unreachable.size() && k < 20; ++k) {
+            maze_cell item;
+            index_position(maze.grid, maze.collectable_cells[route.unreachable[k]], item.layer, item.column, item.row);
+            std::cout << " (layer " << item.layer << ", " << item.column << ", " << item.row << ")";
+        }
+        std::cout << (route.unreachable.size() > 20 ? " ..." : "") << std::endl;
+        return -1;
+    }
+    if (route.timed_out) {
+        std::cout << "No route found within the time budget (" << time_budget << " s)" << std::endl;
+        return -1;
+    }
+    if (route.length < 0) {
+        std::cout << "There is no route back to the start" << std::endl;
+        return -1;
+    }
+    std::cout << "Route: " << route.length << " moves (" << (route.exact ? "optimal order" : "heuristic order") << "), solved in " << solve_seconds << " s on " << pool.size() << " threads" << std::endl;
+    if (!valid_route(maze, route)) {
+        std::cout << "The route does not win the game" << std::endl;
+        return -1;
+    }
+
+    if (path_file) {
+        std::ofstream out(path_file);
+        for (std::size_t k = 0; k < route.cells.size(); ++k)
+            out << route.cells[k].layer << " " << route.cells[k].column << " " << route.cells[k].row << "\n";
+        std::cout << "Rooms of the route (layer column row) written to " << path_file << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,52 @@
+#include <iostream>
+#include <chrono>
+#include <random>
+
+#include "../core/maze_loader.h"
+#include "../core/player.h"
+
+
+// Headless benchmark: steps a player with random inputs through the maze, no window needed
+int main(int argc, char *argv[]) {
+    const char *file_name = argc > 1 ? argv[1] : "input.txt";
+    long long steps = argc > 2 ? std::atoll(argv[2]) : 10000000;
+    std::size_t memory_budget = argc > 3 ? (std::size_t)std::atoll(argv[3]) << 20 : 0;  // MB, binary mazes above it are paged
+
+    maze_model maze;
+    if (!load_maze(maze, file_name, nullptr, memory_budget)) {
+        std::cout << "Failed to load the maze " << file_name << std::endl;
+        return -1;
+    }
+    player_state player;
+    reset_player(player, maze);
+
+    // Random inputs, changed every half a second of simulated time
+    std::mt19937 generator(42);
+    input_state input = {KEY_FORWARD, -90.0f, 0.0f};
+    long long rooms = 0, wins = 0;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (long long i = 0; i < steps; ++i) {
+        if (i % 60 == 0) {
+            input.keys = generator() & (KEY_FORWARD | KEY_BACKWARD | KEY_LEFT | KEY_RIGHT);
+            input.yaw = (float)(generator() % 360);
+        }
+        int events = step(maze, player, input, 1.0f / 120.0f);
+        if (events & EVENT_ROOM_CHANGED)
+            ++rooms;
+        if (events & (EVENT_ROOM_CHANGED | EVENT_LAYER_CHANGED))
+            prefetch_ahead(maze, player, input);
+        if (events & EVENT_WON) {
+            ++wins;
+            restart_game(maze, player);
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << steps << " steps in " << seconds << " s (" << steps / seconds / 1e6 << " M steps/s)" << std::endl;
+    std::cout << "Rooms entered: " << rooms << ", items collected: " << player.collectables << "/" << maze.total_collectables << ", wins: " << wins << std::endl;
+    std::cout << "Final position: " << player.position.x << " " << player.position.z << " (layer " << player.layer << ")" << std::endl;
+    if (maze.grid.cells.paged())
+        std::cout << "Paged: " << maze.grid.cells.paged()->loads() << " chunk loads, " << (maze.grid.cells.paged()->resident_bytes() >> 20) << " MB resident" << std::endl;
+    return 0;
+}